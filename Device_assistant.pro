@@ -9,22 +9,65 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    bufferpool.cpp \
+    capturemodel.cpp \
+    capturereader.cpp \
+    captureviewer.cpp \
+    capturewriter.cpp \
+    checkpoint.cpp \
+    clidownloader.cpp \
+    columnarwriter.cpp \
+    commandstats.cpp \
     communicator.cpp \
     connector.cpp \
+    crc16.cpp \
+    devicesimulator.cpp \
     downloader.cpp \
+    downloadmetrics.cpp \
+    downloadoutput.cpp \
+    downloadsession.cpp \
+    link.cpp \
     logger.cpp \
     main.cpp \
     mainwindow.cpp \
+    metricsview.cpp \
+    multisession.cpp \
+    packetpipeline.cpp \
     parser.cpp \
+    psdanalysis.cpp \
+    rawseries.cpp \
     serialport.cpp
 
 HEADERS += \
+    boundedqueue.h \
+    bufferpool.h \
+    capturemodel.h \
+    capturereader.h \
+    captureviewer.h \
+    capturewriter.h \
+    checkpoint.h \
+    clidownloader.h \
+    columnarwriter.h \
+    commandstats.h \
     communicator.h \
     connector.h \
+    crc16.h \
+    devicesimulator.h \
     downloader.h \
+    downloadmetrics.h \
+    downloadoutput.h \
+    downloadsession.h \
+    link.h \
+    lockfreequeue.h \
     logger.h \
     mainwindow.h \
+    metricsview.h \
+    multisession.h \
+    packetpipeline.h \
+    packets.h \
     parser.h \
+    psdanalysis.h \
+    rawseries.h \
     serialport.h
 
 FORMS += \
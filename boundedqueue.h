@@ -0,0 +1,103 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <algorithm>
+#include <utility>
+
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+/**
+ * @brief Thread safe FIFO queue with limited capacity
+ * Push blocks while queue is full, pop blocks while queue is empty, close releases both
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(qsizetype capacity)
+        : capacity(capacity)
+    {
+    }
+
+    /**
+     * @brief Add item to the queue end, wait for free space
+     * @return false if queue is closed
+     */
+    bool push(T item)
+    {
+        QMutexLocker locker(&mutex);
+        while (items.size() >= capacity && isClosed == false)
+        {
+            notFull.wait(&mutex);
+        }
+
+        if (isClosed == true)
+        {
+            return false;
+        }
+
+        items.append(std::move(item));
+        depthMax = std::max(depthMax, items.size());
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    /**
+     * @brief Take item from the queue head, wait for item
+     * @return false if queue is closed and empty
+     */
+    bool pop(T &item)
+    {
+        QMutexLocker locker(&mutex);
+        while (items.isEmpty() && isClosed == false)
+        {
+            notEmpty.wait(&mutex);
+        }
+
+        if (items.isEmpty())
+        {
+            return false;
+        }
+
+        item = items.takeFirst();
+        notFull.wakeOne();
+        return true;
+    }
+
+    /**
+     * @brief Stop accepting new items, remaining items are still available to pop
+     */
+    void close()
+    {
+        QMutexLocker locker(&mutex);
+        isClosed = true;
+        notFull.wakeAll();
+        notEmpty.wakeAll();
+    }
+
+    qsizetype depth()
+    {
+        QMutexLocker locker(&mutex);
+        return items.size();
+    }
+
+    qsizetype maxDepth()
+    {
+        QMutexLocker locker(&mutex);
+        return depthMax;
+    }
+
+private:
+    const qsizetype capacity;
+    QMutex mutex;
+    QWaitCondition notFull;
+    QWaitCondition notEmpty;
+    QList<T> items;
+    qsizetype depthMax = 0;
+    bool isClosed = false;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,69 @@
+#include "bufferpool.h"
+
+#include <utility>
+
+#include <QMutexLocker>
+
+BufferPool::BufferPool(qsizetype bufferSize, qsizetype capacity)
+    : bufferSize(bufferSize)
+    , capacity(capacity)
+{
+    buffers.reserve(capacity);
+}
+
+QByteArray BufferPool::acquire()
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (buffers.isEmpty() == false)
+        {
+            reuseCount++;
+            return buffers.takeLast();
+        }
+    }
+
+    allocationCount++;
+    QByteArray buffer;
+    buffer.reserve(bufferSize);
+    return buffer;
+}
+
+void BufferPool::release(QByteArray &buffer)
+{
+    // Only the last reference is taken back, buffer is empty for the caller anyway
+    QByteArray released = std::exchange(buffer, QByteArray());
+    if (released.isDetached() == false)
+    {
+        return;
+    }
+
+    // Size is reset, capacity is kept
+    released.resize(0);
+
+    QMutexLocker locker(&mutex);
+    if (buffers.size() < capacity)
+    {
+        buffers.append(std::move(released));
+    }
+}
+
+qint64 BufferPool::allocations() const
+{
+    return allocationCount;
+}
+
+qint64 BufferPool::reuses() const
+{
+    return reuseCount;
+}
+
+void BufferPool::resetStats()
+{
+    allocationCount = 0;
+    reuseCount = 0;
+}
+
+QString BufferPool::statsText() const
+{
+    return QString::number(allocationCount.load()) + " allocated, " + QString::number(reuseCount.load()) + " reused";
+}
@@ -0,0 +1,39 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <atomic>
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+/**
+ * @brief Pool of reusable byte buffers, thread safe
+ * Buffer is taken for exclusive use and given back by its last consumer. Buffer still shared
+ * with someone else isn't taken back, so the pool allocates a new one when it runs out.
+ * Allocation counter stays the same in steady state when all buffers come back.
+ */
+class BufferPool
+{
+public:
+    BufferPool(qsizetype bufferSize, qsizetype capacity);
+
+    QByteArray acquire();
+    void release(QByteArray &buffer);
+
+    qint64 allocations() const;
+    qint64 reuses() const;
+    void resetStats();
+    QString statsText() const;
+
+private:
+    const qsizetype bufferSize;
+    const qsizetype capacity;
+    QMutex mutex;
+    QList<QByteArray> buffers;
+    std::atomic<qint64> allocationCount = 0;
+    std::atomic<qint64> reuseCount = 0;
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,63 @@
+#include "capturemodel.h"
+
+#include "parser.h"
+
+CaptureModel::CaptureModel(const CaptureReader *reader, QObject *parent)
+    : QAbstractListModel{parent}
+    , reader(reader)
+{
+}
+
+void CaptureModel::showAll()
+{
+    beginResetModel();
+    isFiltered = false;
+    filteredPackets.clear();
+    endResetModel();
+}
+
+void CaptureModel::showPackets(const QList<qsizetype> &packets)
+{
+    beginResetModel();
+    isFiltered = true;
+    filteredPackets = packets;
+    endResetModel();
+}
+
+qsizetype CaptureModel::packetIndex(const QModelIndex &index) const
+{
+    if (index.isValid() == false || index.row() >= rowCount())
+    {
+        return -1;
+    }
+
+    return isFiltered ? filteredPackets.at(index.row()) : index.row();
+}
+
+int CaptureModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+    {
+        return 0;
+    }
+
+    return static_cast<int>(isFiltered ? filteredPackets.size() : reader->packetCount());
+}
+
+QVariant CaptureModel::data(const QModelIndex &index, int role) const
+{
+    if (role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    const qsizetype packet = packetIndex(index);
+    if (packet < 0)
+    {
+        return QVariant();
+    }
+
+    const CaptureIndexRecord &record = reader->record(packet);
+    return "Packet " + QString::number(packet) + ", sensor " + QString::number(record.sensorType) + ": " +
+           Parser::toSummary(reader->packet(packet));
+}
@@ -0,0 +1,35 @@
+#ifndef CAPTUREMODEL_H
+#define CAPTUREMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QModelIndex>
+#include <QVariant>
+
+#include "capturereader.h"
+
+/**
+ * @brief Packets of the opened capture for the list view
+ * Rows are described on demand when the view shows them, nothing is prepared per packet
+ */
+class CaptureModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit CaptureModel(const CaptureReader *reader, QObject *parent = nullptr);
+
+    void showAll();
+    void showPackets(const QList<qsizetype> &packets);
+    qsizetype packetIndex(const QModelIndex &index) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    const CaptureReader *reader = nullptr;
+    // Selected packets, all packets are shown when not filtered
+    bool isFiltered = false;
+    QList<qsizetype> filteredPackets;
+};
+
+#endif // CAPTUREMODEL_H
@@ -0,0 +1,250 @@
+#include "capturereader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QDebug>
+#include <QStringList>
+
+#include "packets.h"
+#include "rawseries.h"
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+bool CaptureReader::open(const QString &fileName)
+{
+    close();
+
+    const QString base = baseName(fileName);
+    rawFile.setFileName(base + CaptureWriter::rawSuffix);
+    bool result = rawFile.open(QIODevice::ReadOnly);
+    if (result == false)
+    {
+        qCritical() << "File open failed:" << rawFile.errorString();
+        return false;
+    }
+
+    rawSize = rawFile.size();
+    if (rawSize > 0)
+    {
+        rawData = rawFile.map(0, rawSize);
+        if (rawData == nullptr)
+        {
+            qCritical() << "File map failed:" << rawFile.errorString();
+            close();
+            return false;
+        }
+    }
+
+    // Captures written before the index was introduced are walked packet by packet
+    const QString indexFileName = base + CaptureWriter::indexSuffix;
+    result = QFile::exists(indexFileName) ? mapIndex(indexFileName) : walkPackets();
+    if (result == false)
+    {
+        close();
+        return false;
+    }
+
+    // Drop packets which aren't in the raw file completely
+    while (recordCount > 0 && records[recordCount - 1].offset + records[recordCount - 1].size > static_cast<uint64_t>(rawSize))
+    {
+        recordCount--;
+    }
+
+    for (qsizetype index = 0; index < recordCount; index++)
+    {
+        maxDurationMs = std::max(maxDurationMs, records[index].durationMs);
+        if (index > 0 && records[index].startEpochTime < records[index - 1].startEpochTime)
+        {
+            isTimeOrdered = false;
+        }
+    }
+
+    qInfo() << "Capture opened:" << rawFile.fileName() << recordCount << "packet(s)"
+            << (isTimeOrdered ? "" : ", not ordered by time");
+
+    return true;
+}
+
+void CaptureReader::close()
+{
+    // Mapped memory is released on file close
+    rawFile.close();
+    indexFile.close();
+    rawData = nullptr;
+    rawSize = 0;
+    records = nullptr;
+    recordCount = 0;
+    walkedRecords.clear();
+    isTimeOrdered = true;
+    maxDurationMs = 0;
+}
+
+qsizetype CaptureReader::packetCount() const
+{
+    return recordCount;
+}
+
+const CaptureIndexRecord &CaptureReader::record(qsizetype index) const
+{
+    Q_ASSERT(index >= 0 && index < recordCount);
+    return records[index];
+}
+
+QByteArray CaptureReader::packet(qsizetype index) const
+{
+    // Packet data refers to the mapped file and is valid until the capture is closed
+    const CaptureIndexRecord &packetRecord = record(index);
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(rawData) + packetRecord.offset, packetRecord.size);
+}
+
+QList<qsizetype> CaptureReader::selectTimeRange(uint32_t fromTime, uint32_t toTime) const
+{
+    QList<qsizetype> indexes;
+
+    const CaptureIndexRecord *begin = records;
+    const CaptureIndexRecord *end = records + recordCount;
+    if (isTimeOrdered == true)
+    {
+        // Only packets starting no earlier than the longest packet duration before the range can overlap it
+        const uint32_t maxDuration = (maxDurationMs + 999) / 1000;
+        const uint32_t earliestStart = (fromTime > maxDuration) ? fromTime - maxDuration : 0;
+        begin = std::lower_bound(begin, end, earliestStart,
+                                 [](const CaptureIndexRecord &record, uint32_t time) {
+                                     return record.startEpochTime < time;
+                                 });
+        end = std::upper_bound(begin, end, toTime,
+                               [](uint32_t time, const CaptureIndexRecord &record) {
+                                   return time < record.startEpochTime;
+                               });
+    }
+
+    for (const CaptureIndexRecord *record = begin; record < end; record++)
+    {
+        if (isOverlapped(*record, fromTime, toTime))
+        {
+            indexes.append(record - records);
+        }
+    }
+
+    return indexes;
+}
+
+QString CaptureReader::fileName() const
+{
+    return rawFile.fileName();
+}
+
+QString CaptureReader::baseName(const QString &fileName)
+{
+    const QStringList suffixes = {CaptureWriter::rawSuffix, CaptureWriter::indexSuffix};
+    for (const QString &suffix : suffixes)
+    {
+        if (fileName.endsWith(suffix))
+        {
+            return fileName.left(fileName.size() - suffix.size());
+        }
+    }
+
+    return fileName;
+}
+
+bool CaptureReader::mapIndex(const QString &indexFileName)
+{
+    indexFile.setFileName(indexFileName);
+    bool result = indexFile.open(QIODevice::ReadOnly);
+    if (result == false)
+    {
+        qCritical() << "File open failed:" << indexFile.errorString();
+        return false;
+    }
+
+    const qint64 indexSize = indexFile.size();
+    const uchar *indexData = (indexSize > 0) ? indexFile.map(0, indexSize) : nullptr;
+
+    CaptureIndexHeader header;
+    if (indexData == nullptr || indexSize < static_cast<qint64>(sizeof(header)))
+    {
+        qCritical() << "File" << indexFileName << "isn't a capture index";
+        return false;
+    }
+
+    memcpy(&header, indexData, sizeof(header));
+    if (memcmp(header.magic, CaptureIndexHeader::magicValue, sizeof(header.magic)) != 0 ||
+        header.version != CaptureIndexHeader::versionValue ||
+        header.headerSize < sizeof(CaptureIndexHeader) || header.headerSize % alignof(CaptureIndexRecord) != 0 ||
+        header.recordSize != sizeof(CaptureIndexRecord))
+    {
+        qCritical() << "File" << indexFileName << "isn't a capture index";
+        return false;
+    }
+
+    // Mapping is page aligned and header size keeps records aligned, so they are used in place.
+    // Record being written when download was interrupted is ignored.
+    records = reinterpret_cast<const CaptureIndexRecord*>(indexData + header.headerSize);
+    recordCount = std::max<qint64>(indexSize - header.headerSize, 0) / header.recordSize;
+
+    return true;
+}
+
+bool CaptureReader::walkPackets()
+{
+    qWarning() << "Capture index isn't found, walk packets of" << rawFile.fileName();
+
+    qint64 offset = 0;
+    while (offset + static_cast<qint64>(sizeof(PacketHeader)) <= rawSize)
+    {
+        PacketHeader packetHeader;
+        memcpy(&packetHeader, rawData + offset, sizeof(packetHeader));
+
+        // Packet size follows from its data type, PSD size from its points count, Raw from its duration
+        qint64 size = sizeof(PacketHeader);
+        if (packetHeader.dataType == static_cast<uint8_t>(DataType::Psd) &&
+            offset + size + static_cast<qint64>(sizeof(PsdHeader)) <= rawSize)
+        {
+            PsdHeader psdHeader;
+            memcpy(&psdHeader, rawData + offset + size, sizeof(psdHeader));
+            size += sizeof(PsdHeader) + static_cast<qint64>(psdHeader.points) * sizeof(PsdPoint);
+        }
+        else if (packetHeader.dataType == static_cast<uint8_t>(DataType::Statistic))
+        {
+            size += sizeof(StatisticData);
+        }
+        else if (packetHeader.dataType == static_cast<uint8_t>(DataType::Raw) && packetHeader.sampleTimeMs > 0)
+        {
+            size += RawSeries::expectedSize(packetHeader);
+        }
+        else
+        {
+            qWarning() << "Packet size at offset" << offset << "is unknown, rest of the capture is skipped";
+            break;
+        }
+
+        CaptureIndexRecord record = {};
+        record.offset = offset;
+        record.size = static_cast<uint32_t>(size);
+        record.startEpochTime = packetHeader.startEpochTime;
+        record.durationMs = packetHeader.durationMs;
+        record.sampleTimeMs = packetHeader.sampleTimeMs;
+        record.dataType = packetHeader.dataType;
+        record.sensorType = packetHeader.sensorType;
+        walkedRecords.append(record);
+
+        offset += size;
+    }
+
+    records = walkedRecords.constData();
+    recordCount = walkedRecords.size();
+
+    return true;
+}
+
+bool CaptureReader::isOverlapped(const CaptureIndexRecord &record, uint32_t fromTime, uint32_t toTime)
+{
+    const uint64_t startTime = record.startEpochTime;
+    const uint64_t endTime = startTime + (record.durationMs + 999) / 1000;
+    return startTime <= toTime && endTime >= fromTime;
+}
@@ -0,0 +1,51 @@
+#ifndef CAPTUREREADER_H
+#define CAPTUREREADER_H
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#include "capturewriter.h"
+
+/**
+ * @brief Raw capture reader
+ * Raw and index files are memory mapped, so opening doesn't depend on the capture size
+ * and packets are returned without copying. Raw file without index is walked by packet headers.
+ */
+class CaptureReader
+{
+public:
+    ~CaptureReader();
+
+    bool open(const QString &fileName);
+    void close();
+
+    qsizetype packetCount() const;
+    const CaptureIndexRecord &record(qsizetype index) const;
+    QByteArray packet(qsizetype index) const;
+    QList<qsizetype> selectTimeRange(uint32_t fromTime, uint32_t toTime) const;
+    QString fileName() const;
+
+    static QString baseName(const QString &fileName);
+
+private:
+    bool mapIndex(const QString &indexFileName);
+    bool walkPackets();
+    static bool isOverlapped(const CaptureIndexRecord &record, uint32_t fromTime, uint32_t toTime);
+
+    QFile rawFile;
+    QFile indexFile;
+    const uchar *rawData = nullptr;
+    qint64 rawSize = 0;
+    // Records point either to the mapped index or to the walked ones
+    const CaptureIndexRecord *records = nullptr;
+    qsizetype recordCount = 0;
+    QList<CaptureIndexRecord> walkedRecords;
+    bool isTimeOrdered = true;
+    uint32_t maxDurationMs = 0;
+};
+
+#endif // CAPTUREREADER_H
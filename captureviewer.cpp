@@ -0,0 +1,99 @@
+#include "captureviewer.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileDialog>
+
+#include "parser.h"
+
+CaptureViewer::CaptureViewer(Ui::MainWindow *ui, QObject *parent)
+    : QObject{parent}
+    , ui(ui)
+    , model(new CaptureModel(&reader, this))
+{
+    ui->listViewCapture->setModel(model);
+
+    connect(ui->pushButtonOpenCapture, &QPushButton::clicked, this, &CaptureViewer::open);
+    connect(ui->pushButtonCaptureSelect, &QPushButton::clicked, this, &CaptureViewer::selectTimeRange);
+    connect(ui->pushButtonCaptureAll, &QPushButton::clicked, this, &CaptureViewer::showAll);
+    connect(ui->listViewCapture->selectionModel(), &QItemSelectionModel::currentChanged, this, &CaptureViewer::onPacketSelected);
+}
+
+CaptureViewer::~CaptureViewer()
+{
+}
+
+void CaptureViewer::open()
+{
+    QString fileName = QFileDialog::getOpenFileName(ui->centralwidget, "Open capture", QString(),
+                                                    "Raw capture (*.bin *.idx)");
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    // View mustn't access packets of the closed capture
+    model->showPackets({});
+    ui->textBrowserCapture->clear();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool result = reader.open(fileName);
+    if (result == false)
+    {
+        ui->labelCaptureInfo->setText("Capture open failed: " + fileName);
+        return;
+    }
+
+    QString info = reader.fileName() + ": " + QString::number(reader.packetCount()) + " packet(s)";
+    if (reader.packetCount() > 0)
+    {
+        const auto firstTime = QDateTime::fromSecsSinceEpoch(reader.record(0).startEpochTime);
+        const auto lastTime = QDateTime::fromSecsSinceEpoch(reader.record(reader.packetCount() - 1).startEpochTime);
+        ui->dateTimeEditCaptureFrom->setDateTime(firstTime);
+        ui->dateTimeEditCaptureTo->setDateTime(lastTime);
+        info += ", " + firstTime.toString("yyyy-MM-dd hh:mm:ss") + " - " + lastTime.toString("yyyy-MM-dd hh:mm:ss");
+    }
+    info += ", opened in " + QString::number(timer.elapsed()) + " ms";
+    ui->labelCaptureInfo->setText(info);
+    qInfo() << info;
+
+    model->showAll();
+}
+
+void CaptureViewer::selectTimeRange()
+{
+    const qint64 fromTime = ui->dateTimeEditCaptureFrom->dateTime().toSecsSinceEpoch();
+    const qint64 toTime = ui->dateTimeEditCaptureTo->dateTime().toSecsSinceEpoch();
+    if (fromTime > toTime || fromTime < 0)
+    {
+        qWarning() << "Invalid capture time range";
+        return;
+    }
+
+    const QList<qsizetype> packets = reader.selectTimeRange(static_cast<uint32_t>(fromTime), static_cast<uint32_t>(toTime));
+    qInfo() << "Selected" << packets.size() << "packet(s) of the capture";
+    model->showPackets(packets);
+}
+
+void CaptureViewer::showAll()
+{
+    model->showAll();
+}
+
+void CaptureViewer::onPacketSelected(const QModelIndex &current)
+{
+    const qsizetype packet = model->packetIndex(current);
+    if (packet < 0)
+    {
+        ui->textBrowserCapture->clear();
+        return;
+    }
+
+    // Only the selected packet is decoded
+    QByteArray jsonData;
+    bool result = Parser::toJson(reader.packet(packet), jsonData);
+    ui->textBrowserCapture->setPlainText(result ? QString::fromUtf8(jsonData) : QString("Packet decoding failed"));
+}
@@ -0,0 +1,33 @@
+#ifndef CAPTUREVIEWER_H
+#define CAPTUREVIEWER_H
+
+#include <QModelIndex>
+#include <QObject>
+
+#include "capturemodel.h"
+#include "capturereader.h"
+#include "ui_MainWindow.h"
+
+/**
+ * @brief Viewer of previously downloaded raw captures, works without connected device
+ */
+class CaptureViewer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CaptureViewer(Ui::MainWindow *ui, QObject *parent = nullptr);
+    ~CaptureViewer();
+
+private slots:
+    void open();
+    void selectTimeRange();
+    void showAll();
+    void onPacketSelected(const QModelIndex &current);
+
+private:
+    Ui::MainWindow *ui = nullptr;
+    CaptureReader reader;
+    CaptureModel *model = nullptr;
+};
+
+#endif // CAPTUREVIEWER_H
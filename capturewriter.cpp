@@ -0,0 +1,131 @@
+#include "capturewriter.h"
+
+#include <cstring>
+
+#include <QDebug>
+
+#include "packets.h"
+
+bool CaptureWriter::open(const QString &baseName)
+{
+    rawSize = 0;
+
+    rawFile.setFileName(baseName + rawSuffix);
+    indexFile.setFileName(baseName + indexSuffix);
+    qDebug() << "Open file:" << rawFile.fileName();
+
+    bool result = rawFile.open(QIODevice::WriteOnly) && indexFile.open(QIODevice::WriteOnly);
+    if (result == false)
+    {
+        qCritical() << "File open failed:" << rawFile.errorString() << indexFile.errorString();
+        rawFile.close();
+        indexFile.close();
+        return false;
+    }
+
+    CaptureIndexHeader header = {};
+    memcpy(header.magic, CaptureIndexHeader::magicValue, sizeof(header.magic));
+    header.version = CaptureIndexHeader::versionValue;
+    header.headerSize = sizeof(CaptureIndexHeader);
+    header.recordSize = sizeof(CaptureIndexRecord);
+
+    const qint64 headerSize = sizeof(header);
+    result = (indexFile.write(reinterpret_cast<const char*>(&header), headerSize) == headerSize);
+    if (result == false)
+    {
+        qCritical() << "File write failed:" << indexFile.errorString();
+    }
+
+    return result;
+}
+
+bool CaptureWriter::resume(const QString &baseName, qint64 packetCount, qint64 committedRawSize)
+{
+    rawSize = committedRawSize;
+
+    rawFile.setFileName(baseName + rawSuffix);
+    indexFile.setFileName(baseName + indexSuffix);
+    qDebug() << "Open file:" << rawFile.fileName();
+
+    bool result = rawFile.open(QIODevice::ReadWrite) && indexFile.open(QIODevice::ReadWrite);
+    if (result == false)
+    {
+        qCritical() << "File open failed:" << rawFile.errorString() << indexFile.errorString();
+        rawFile.close();
+        indexFile.close();
+        return false;
+    }
+
+    // Drop everything written after the last committed packet
+    const qint64 indexSize = sizeof(CaptureIndexHeader) + packetCount * sizeof(CaptureIndexRecord);
+    if (rawFile.size() < rawSize || indexFile.size() < indexSize)
+    {
+        qCritical() << "File" << rawFile.fileName() << "is shorter than committed data";
+        rawFile.close();
+        indexFile.close();
+        return false;
+    }
+
+    result = rawFile.resize(rawSize) && indexFile.resize(indexSize) &&
+             rawFile.seek(rawSize) && indexFile.seek(indexSize);
+    if (result == false)
+    {
+        qCritical() << "File resume failed:" << rawFile.errorString() << indexFile.errorString();
+        rawFile.close();
+        indexFile.close();
+    }
+
+    return result;
+}
+
+bool CaptureWriter::write(const QByteArray &rawData)
+{
+    CaptureIndexRecord record = {};
+    record.offset = rawSize;
+    record.size = static_cast<uint32_t>(rawData.size());
+
+    // Packet is stored even if its header is damaged, the index just doesn't describe it
+    if (rawData.size() >= static_cast<qsizetype>(sizeof(PacketHeader)))
+    {
+        PacketHeader packetHeader;
+        memcpy(&packetHeader, rawData.constData(), sizeof(PacketHeader));
+        record.startEpochTime = packetHeader.startEpochTime;
+        record.durationMs = packetHeader.durationMs;
+        record.sampleTimeMs = packetHeader.sampleTimeMs;
+        record.dataType = packetHeader.dataType;
+        record.sensorType = packetHeader.sensorType;
+    }
+
+    if (rawFile.write(rawData) != rawData.size())
+    {
+        qCritical() << "File write failed:" << rawFile.errorString();
+        return false;
+    }
+
+    const qint64 recordSize = sizeof(CaptureIndexRecord);
+    if (indexFile.write(reinterpret_cast<const char*>(&record), recordSize) != recordSize)
+    {
+        qCritical() << "File write failed:" << indexFile.errorString();
+        return false;
+    }
+
+    rawSize += rawData.size();
+    return true;
+}
+
+bool CaptureWriter::flush()
+{
+    return rawFile.flush() && indexFile.flush();
+}
+
+void CaptureWriter::close()
+{
+    rawFile.close();
+    indexFile.close();
+    qDebug() << "File closed:" << rawFile.fileName();
+}
+
+QString CaptureWriter::fileName() const
+{
+    return rawFile.fileName();
+}
@@ -0,0 +1,67 @@
+#ifndef CAPTUREWRITER_H
+#define CAPTUREWRITER_H
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+/**
+ * @brief Raw capture: packets as received from the device with the index of them
+ *
+ * "<capture>.bin" - raw packets one after another, exactly as received
+ * "<capture>.idx" - CaptureIndexHeader followed by CaptureIndexRecord per packet, little endian
+ *
+ * Number of packets is taken from the index file size, so index is valid after every
+ * appended record and needs no finalization. Packets are decoded lazily by the reader.
+ */
+struct CaptureIndexHeader
+{
+    static constexpr char magicValue[8] = {'P', 'S', 'D', 'I', 'D', 'X', 0, 0};
+    static constexpr uint32_t versionValue = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+struct CaptureIndexRecord
+{
+    // Packet position in the raw file
+    uint64_t offset;
+    uint32_t size;
+    // Packet header fields
+    uint32_t startEpochTime;
+    uint32_t durationMs;
+    uint16_t sampleTimeMs;
+    uint8_t dataType;
+    uint8_t sensorType;
+};
+
+static_assert(sizeof(CaptureIndexHeader) == 24, "Unexpected capture index header size");
+static_assert(sizeof(CaptureIndexRecord) == 24, "Unexpected capture index record size");
+
+class CaptureWriter
+{
+public:
+    static constexpr const char *rawSuffix = ".bin";
+    static constexpr const char *indexSuffix = ".idx";
+
+    bool open(const QString &baseName);
+    bool resume(const QString &baseName, qint64 packetCount, qint64 committedRawSize);
+    bool write(const QByteArray &rawData);
+    bool flush();
+    void close();
+
+    QString fileName() const;
+
+private:
+    QFile rawFile;
+    QFile indexFile;
+    qint64 rawSize = 0;
+};
+
+#endif // CAPTUREWRITER_H
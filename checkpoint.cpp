@@ -0,0 +1,115 @@
+#include "checkpoint.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+namespace
+{
+constexpr int checkpointVersion = 1;
+}
+
+bool Checkpoint::save(const QString &fileName) const
+{
+    QJsonObject requestJson;
+    requestJson["historic"] = request.isHistoric;
+    requestJson["start time"] = static_cast<qint64>(request.startTime);
+    requestJson["packet from"] = request.packetFromId;
+    requestJson["packet to"] = request.packetToId;
+    requestJson["sensor type"] = request.sensorType;
+    requestJson["data type"] = request.dataType;
+    requestJson["sensor name"] = request.sensorName;
+    requestJson["data name"] = request.dataName;
+    requestJson["pipeline window"] = request.pipelineWindow;
+    requestJson["json compact"] = request.isJsonCompact;
+    requestJson["export format"] = static_cast<int>(request.exportFormat);
+    requestJson["raw decimation"] = request.rawDecimation;
+    requestJson["psd analysis"] = request.isPsdAnalysis;
+    requestJson["psd bands"] = request.psdBands;
+    requestJson["psd db"] = request.isPsdDecibels;
+
+    QJsonObject committedJson;
+    committedJson["packets"] = committed.packets;
+    committedJson["raw bytes"] = committed.rawBytes;
+    committedJson["output bytes"] = committed.outputBytes;
+    committedJson["output values"] = committed.outputValues;
+
+    QJsonObject json;
+    json["version"] = checkpointVersion;
+    json["request"] = requestJson;
+    json["base name"] = baseName;
+    json["download size"] = downloadSize;
+    json["committed"] = committedJson;
+
+    // Checkpoint is replaced atomically, so it's never left half written
+    QSaveFile file(fileName);
+    bool result = file.open(QIODevice::WriteOnly);
+    if (result == true)
+    {
+        file.write(QJsonDocument(json).toJson(QJsonDocument::Indented));
+        result = file.commit();
+    }
+
+    if (result == false)
+    {
+        qCritical() << "Checkpoint save failed:" << file.errorString();
+    }
+
+    return result;
+}
+
+bool Checkpoint::load(const QString &fileName)
+{
+    QFile file(fileName);
+    bool result = file.open(QIODevice::ReadOnly);
+    if (result == false)
+    {
+        qCritical() << "Checkpoint open failed:" << file.errorString();
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (document.isObject() == false)
+    {
+        qCritical() << "Checkpoint parse failed:" << error.errorString();
+        return false;
+    }
+
+    QJsonObject json = document.object();
+    if (json["version"].toInt() != checkpointVersion)
+    {
+        qCritical() << "Checkpoint version" << json["version"].toInt() << "isn't supported";
+        return false;
+    }
+
+    QJsonObject requestJson = json["request"].toObject();
+    request.isHistoric = requestJson["historic"].toBool();
+    request.startTime = static_cast<time_t>(requestJson["start time"].toInteger());
+    request.packetFromId = requestJson["packet from"].toInt();
+    request.packetToId = requestJson["packet to"].toInt();
+    request.sensorType = requestJson["sensor type"].toInt();
+    request.dataType = requestJson["data type"].toInt();
+    request.sensorName = requestJson["sensor name"].toString();
+    request.dataName = requestJson["data name"].toString();
+    request.pipelineWindow = requestJson["pipeline window"].toInt(1);
+    request.isJsonCompact = requestJson["json compact"].toBool();
+    request.exportFormat = static_cast<ExportFormat>(requestJson["export format"].toInt());
+    request.rawDecimation = requestJson["raw decimation"].toInt(1);
+    request.isPsdAnalysis = requestJson["psd analysis"].toBool();
+    request.psdBands = requestJson["psd bands"].toString();
+    request.isPsdDecibels = requestJson["psd db"].toBool();
+
+    QJsonObject committedJson = json["committed"].toObject();
+    committed.packets = committedJson["packets"].toInteger();
+    committed.rawBytes = committedJson["raw bytes"].toInteger();
+    committed.outputBytes = committedJson["output bytes"].toInteger();
+    committed.outputValues = committedJson["output values"].toInteger();
+
+    baseName = json["base name"].toString();
+    downloadSize = json["download size"].toInt();
+
+    return baseName.isEmpty() == false;
+}
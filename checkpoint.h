@@ -0,0 +1,25 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <QString>
+
+#include "downloadoutput.h"
+#include "downloadsession.h"
+
+/**
+ * @brief Download progress saved next to the output files to resume interrupted download
+ */
+struct Checkpoint
+{
+    static constexpr const char *fileSuffix = ".checkpoint";
+
+    DownloadRequest request;
+    QString baseName;
+    int downloadSize = 0;
+    DownloadOutput::State committed;
+
+    bool save(const QString &fileName) const;
+    bool load(const QString &fileName);
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,411 @@
+#include "clidownloader.h"
+
+#include <cstring>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+
+#include "psdanalysis.h"
+
+namespace
+{
+const char *cliOption = "--cli";
+
+// Same order as the download tab type selectors
+const char *sensorNames[] = {"Accel X", "Accel Y", "Accel Z", "Accel Result", "Gyro X", "Gyro Y", "Gyro Z",
+                             "Roll", "Pitch", "Adc 1", "Adc 2"};
+const char *dataNames[] = {"Psd", "Statistic", "Raw"};
+// Same order as ExportFormat
+const char *formatNames[] = {"json", "columnar", "raw", "raw-csv", "raw-binary"};
+
+/**
+ * @brief Finds type by its index or name (case insensitive)
+ */
+template <size_t N>
+int findName(const char *(&names)[N], const QString &text)
+{
+    bool isNumber = false;
+    int index = text.toInt(&isNumber);
+    if (isNumber == true)
+    {
+        return (index >= 0 && index < static_cast<int>(N)) ? index : -1;
+    }
+
+    for (size_t i = 0; i < N; i++)
+    {
+        if (text.compare(names[i], Qt::CaseInsensitive) == 0)
+        {
+            return static_cast<int>(i);
+        }
+    }
+
+    return -1;
+}
+}
+
+bool CliDownloader::isRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], cliOption) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+CliDownloader::CliDownloader(QObject *parent)
+    : QObject{parent}
+{
+    startupTimer.start();
+}
+
+CliDownloader::~CliDownloader()
+{
+    // Stop I/O thread before the application is destroyed
+    delete link;
+}
+
+bool CliDownloader::start(const QStringList &arguments)
+{
+    bool result = parseArguments(arguments);
+    if (result == false)
+    {
+        return false;
+    }
+
+    link = new Link("I/O thread");
+    SerialPort *port = link->serialPort();
+
+    // Link objects live in the I/O thread, so their signals are queued to the main thread
+    connect(port, &SerialPort::opened, this, &CliDownloader::onPortOpened);
+    connect(port, &SerialPort::openFailed, this, &CliDownloader::onPortOpenFailed);
+    connect(link->communicator(), &Communicator::linkReady, this, &CliDownloader::onLinkReady);
+    connect(link->downloadSession(), &DownloadSession::metricsChanged, this, &CliDownloader::onMetricsChanged);
+    connect(link->downloadSession(), &DownloadSession::finished, this, &CliDownloader::onFinished);
+
+    QString name = portName;
+    int rate = baudRate;
+    QMetaObject::invokeMethod(port, [port, name, rate](){
+        port->open(name, rate);
+    });
+
+    return true;
+}
+
+int CliDownloader::exitCode() const
+{
+    return static_cast<int>(code);
+}
+
+void CliDownloader::onPortOpened()
+{
+    // First keep alive is sent on open
+    startupMs = startupTimer.elapsed();
+    qInfo() << "Port opened in" << startupMs << "ms";
+    linkBaudRate = baudRate;
+
+    if (isLinkSetup == true)
+    {
+        Communicator *communicator = link->communicator();
+        QMetaObject::invokeMethod(communicator, [communicator](){
+            communicator->setupLink(Communicator::linkBaudRateMax);
+        });
+    }
+    else
+    {
+        startDownload();
+    }
+}
+
+void CliDownloader::onPortOpenFailed()
+{
+    finish(ExitCode::PortFailed, "Open port " + portName + " failed");
+}
+
+void CliDownloader::onLinkReady(bool result, int baudRate)
+{
+    linkBaudRate = baudRate;
+    if (result == false)
+    {
+        finish(ExitCode::LinkFailed, "Link setup at " + QString::number(baudRate) + " baud failed");
+        return;
+    }
+
+    startDownload();
+}
+
+void CliDownloader::onMetricsChanged(const DownloadMetrics &metrics)
+{
+    lastMetrics = metrics;
+}
+
+void CliDownloader::onFinished(bool result)
+{
+    if (result == true)
+    {
+        finish(ExitCode::Ok);
+    }
+    else
+    {
+        finish(ExitCode::DownloadFailed, "Download failed");
+    }
+}
+
+bool CliDownloader::parseArguments(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless download, JSON summary is written to stdout");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"cli", "Run without GUI."},
+        {"port", "Serial port name, \"Simulator\" for simulated device.", "name"},
+        {"baud", "Baud rate, 115200 by default.", "rate", "115200"},
+        {"link-setup", "Disable device logging and negotiate the highest reliable baud rate."},
+        {"historic", "Download historical data from the start time (ISO date time or epoch seconds), recent data otherwise.", "time"},
+        {"from", "First packet id, 0 by default.", "id", "0"},
+        {"to", "Last packet id, 0 by default.", "id", "0"},
+        {"sensor", "Sensor type name or index, e.g. \"Accel X\".", "type", "0"},
+        {"data", "Data type name or index: Psd, Statistic or Raw.", "type", "0"},
+        {"format", "Output format: json, columnar, raw, raw-csv or raw-binary.", "format", "json"},
+        {"compact", "Compact JSON output."},
+        {"window", "Packet requests in flight, 4 by default.", "count", "4"},
+        {"decimation", "Raw samples averaged for samples output, 1 by default.", "factor", "1"},
+        {"psd-bands", "Add PSD analysis with bands listed as \"from-to\" in Hz, e.g. \"0-100, 100-1000\".", "bands"},
+        {"psd-db", "PSD amplitudes in dB."},
+        {"output-dir", "Directory for the dated output directories, current directory by default.", "dir"},
+        {"resume", "Resume interrupted download from its checkpoint, download options are ignored.", "checkpoint"},
+        {"summary", "Write JSON summary to the file instead of stdout.", "file"},
+        {"verbose", "Log debug messages."},
+    });
+
+    // Help is printed to stdout and the application exits here
+    parser.process(arguments);
+
+    if (parser.isSet("verbose") == false)
+    {
+        QLoggingCategory::setFilterRules("*.debug=false");
+    }
+    summaryFileName = parser.value("summary");
+
+    portName = parser.value("port");
+    if (portName.isEmpty())
+    {
+        finish(ExitCode::InvalidArguments, "Port isn't set");
+        return false;
+    }
+
+    bool isNumber = false;
+    baudRate = parser.value("baud").toInt(&isNumber);
+    if (isNumber == false || baudRate <= 0)
+    {
+        finish(ExitCode::InvalidArguments, "Invalid baud rate: " + parser.value("baud"));
+        return false;
+    }
+    isLinkSetup = parser.isSet("link-setup");
+
+    checkpointFileName = parser.value("resume");
+    if (checkpointFileName.isEmpty() == false)
+    {
+        return true;
+    }
+
+    request.isHistoric = parser.isSet("historic");
+    if (request.isHistoric == true)
+    {
+        const QString time = parser.value("historic");
+        qint64 epochTime = time.toLongLong(&isNumber);
+        if (isNumber == false)
+        {
+            QDateTime dateTime = QDateTime::fromString(time, Qt::ISODate);
+            if (dateTime.isValid() == false)
+            {
+                finish(ExitCode::InvalidArguments, "Invalid start time: " + time);
+                return false;
+            }
+            epochTime = dateTime.toSecsSinceEpoch();
+        }
+        request.startTime = epochTime;
+    }
+
+    bool isFromValid = false;
+    bool isToValid = false;
+    request.packetFromId = parser.value("from").toInt(&isFromValid);
+    request.packetToId = parser.value("to").toInt(&isToValid);
+    if (isFromValid == false || isToValid == false || request.packetFromId < 0 || request.packetFromId > request.packetToId)
+    {
+        finish(ExitCode::InvalidArguments, "Invalid packet range: " + parser.value("from") + " - " + parser.value("to"));
+        return false;
+    }
+
+    request.sensorType = findName(sensorNames, parser.value("sensor"));
+    request.dataType = findName(dataNames, parser.value("data"));
+    int format = findName(formatNames, parser.value("format"));
+    if (request.sensorType < 0 || request.dataType < 0 || format < 0)
+    {
+        finish(ExitCode::InvalidArguments, "Unknown sensor type, data type or format");
+        return false;
+    }
+    request.sensorName = sensorNames[request.sensorType];
+    request.dataName = dataNames[request.dataType];
+    request.exportFormat = static_cast<ExportFormat>(format);
+    request.isJsonCompact = parser.isSet("compact");
+
+    request.pipelineWindow = parser.value("window").toInt(&isNumber);
+    if (isNumber == false || request.pipelineWindow < 1)
+    {
+        finish(ExitCode::InvalidArguments, "Invalid pipeline window: " + parser.value("window"));
+        return false;
+    }
+
+    request.rawDecimation = parser.value("decimation").toInt(&isNumber);
+    if (isNumber == false || request.rawDecimation < 1)
+    {
+        finish(ExitCode::InvalidArguments, "Invalid decimation: " + parser.value("decimation"));
+        return false;
+    }
+
+    request.isPsdAnalysis = parser.isSet("psd-bands");
+    request.psdBands = parser.value("psd-bands");
+    request.isPsdDecibels = parser.isSet("psd-db");
+    QList<PsdAnalysis::Band> bands;
+    if (request.isPsdAnalysis == true && PsdAnalysis::parseBands(request.psdBands, bands) == false)
+    {
+        finish(ExitCode::InvalidArguments, "Invalid PSD bands: " + request.psdBands);
+        return false;
+    }
+
+    request.outputDir = parser.value("output-dir");
+
+    return true;
+}
+
+void CliDownloader::startDownload()
+{
+    DownloadSession *session = link->downloadSession();
+    if (checkpointFileName.isEmpty() == false)
+    {
+        QString fileName = checkpointFileName;
+        QMetaObject::invokeMethod(session, [session, fileName](){
+            session->resume(fileName);
+        });
+    }
+    else
+    {
+        DownloadRequest sessionRequest = request;
+        QMetaObject::invokeMethod(session, [session, sessionRequest](){
+            session->start(sessionRequest);
+        });
+    }
+}
+
+void CliDownloader::finish(ExitCode exitCode, const QString &errorText)
+{
+    code = exitCode;
+    error = errorText;
+    if (error.isEmpty() == false)
+    {
+        qCritical().noquote() << error;
+    }
+
+    bool result = writeSummary();
+    if (result == false && code == ExitCode::Ok)
+    {
+        code = ExitCode::DownloadFailed;
+    }
+
+    if (link != nullptr)
+    {
+        // Device is switched back to the opening rate before exit, so the next run finds it there
+        Communicator *communicator = link->communicator();
+        QMetaObject::invokeMethod(communicator, [communicator](){
+            communicator->closeLink();
+        }, Qt::BlockingQueuedConnection);
+    }
+
+    // Ignored if the event loop isn't running yet, start() returns false then
+    QCoreApplication::exit(static_cast<int>(code));
+}
+
+bool CliDownloader::writeSummary() const
+{
+    qint64 retries = 0;
+    qint64 timeouts = 0;
+    qint64 crcFailures = 0;
+    QJsonObject commandsJson;
+    for (int command = 0; command < static_cast<int>(Communicator::Command::Count); command++)
+    {
+        const CommandStats &stats = lastMetrics.commands[command];
+        retries += stats.retries();
+        timeouts += stats.timeouts();
+        crcFailures += stats.crcFailures();
+        if (stats.samples() == 0 && stats.retries() == 0 && stats.timeouts() == 0)
+        {
+            continue;
+        }
+
+        QJsonObject commandJson;
+        commandJson["samples"] = stats.samples();
+        commandJson["latency avg ms"] = stats.smoothedLatency().count() / 1000.0;
+        commandJson["latency max ms"] = stats.maxLatency().count() / 1000.0;
+        commandJson["retries"] = stats.retries();
+        commandJson["timeouts"] = stats.timeouts();
+        commandJson["crc failures"] = stats.crcFailures();
+        commandsJson[Communicator::commandName(static_cast<Communicator::Command>(command))] = commandJson;
+    }
+
+    const double elapsedSec = static_cast<double>(lastMetrics.elapsedMs) / 1000;
+    QJsonObject json;
+    json["result"] = (code == ExitCode::Ok) ? "ok" : "failed";
+    json["exit code"] = static_cast<int>(code);
+    json["error"] = error;
+    json["port"] = portName;
+    json["baud rate"] = linkBaudRate;
+    json["startup ms"] = startupMs;
+    json["download"] = lastMetrics.description;
+    json["elapsed ms"] = lastMetrics.elapsedMs;
+    json["packets"] = lastMetrics.packets;
+    json["payload bytes"] = lastMetrics.payloadBytes;
+    json["payload rate"] = elapsedSec > 0 ? lastMetrics.payloadBytes / elapsedSec : 0.0;
+    json["received bytes"] = lastMetrics.line.rxBytes;
+    json["sent bytes"] = lastMetrics.line.txBytes;
+    json["corrupted frames"] = lastMetrics.corruptedFrames;
+    json["discarded bytes"] = lastMetrics.discardedBytes;
+    json["retries"] = retries;
+    json["timeouts"] = timeouts;
+    json["crc failures"] = crcFailures;
+    json["commands"] = commandsJson;
+
+    QFile file;
+    bool result = false;
+    if (summaryFileName.isEmpty())
+    {
+        result = file.open(stdout, QIODevice::WriteOnly);
+    }
+    else
+    {
+        file.setFileName(summaryFileName);
+        result = file.open(QIODevice::WriteOnly);
+    }
+
+    if (result == true)
+    {
+        result = (file.write(QJsonDocument(json).toJson(QJsonDocument::Indented)) >= 0);
+        file.close();
+    }
+
+    if (result == false)
+    {
+        qCritical() << "Write summary failed:" << file.errorString();
+    }
+
+    return result;
+}
@@ -0,0 +1,69 @@
+#ifndef CLIDOWNLOADER_H
+#define CLIDOWNLOADER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "downloadmetrics.h"
+#include "downloadsession.h"
+#include "link.h"
+
+/**
+ * @brief Headless download driven by command line arguments, runs without widgets in QCoreApplication
+ * Log goes to stderr, JSON summary of the download to stdout or summary file
+ */
+class CliDownloader : public QObject
+{
+    Q_OBJECT
+public:
+    enum class ExitCode
+    {
+        Ok = 0,
+        InvalidArguments = 1,
+        PortFailed = 2,
+        LinkFailed = 3,
+        DownloadFailed = 4,
+    };
+
+    static bool isRequested(int argc, char *argv[]);
+
+    explicit CliDownloader(QObject *parent = nullptr);
+    ~CliDownloader();
+
+    bool start(const QStringList &arguments);
+    int exitCode() const;
+
+private slots:
+    void onPortOpened();
+    void onPortOpenFailed();
+    void onLinkReady(bool result, int baudRate);
+    void onMetricsChanged(const DownloadMetrics &metrics);
+    void onFinished(bool result);
+
+private:
+    bool parseArguments(const QStringList &arguments);
+    void startDownload();
+    void finish(ExitCode code, const QString &errorText = QString());
+    bool writeSummary() const;
+
+    QElapsedTimer startupTimer;
+    qint64 startupMs = -1;
+    Link *link = nullptr;
+
+    QString portName;
+    int baudRate = 115200;
+    bool isLinkSetup = false;
+    // Baud rate after link setup
+    int linkBaudRate = 0;
+    DownloadRequest request;
+    QString checkpointFileName;
+    QString summaryFileName;
+
+    DownloadMetrics lastMetrics;
+    ExitCode code = ExitCode::Ok;
+    QString error;
+};
+
+#endif // CLIDOWNLOADER_H
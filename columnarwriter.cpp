@@ -0,0 +1,259 @@
+#include "columnarwriter.h"
+
+#include <cstring>
+
+#include <QDebug>
+
+#include "packets.h"
+
+namespace
+{
+constexpr qint64 sectionAlignment = 8;
+const char *recordsFileSuffix = ".records";
+}
+
+bool ColumnarWriter::open(const QString &fileName)
+{
+    records.clear();
+    valuesCount = 0;
+
+    file.setFileName(fileName);
+    bool result = file.open(QIODevice::WriteOnly);
+    if (result == false)
+    {
+        qCritical() << "File open failed:" << file.errorString();
+        return false;
+    }
+
+    recordsFile.setFileName(fileName + recordsFileSuffix);
+    result = recordsFile.open(QIODevice::WriteOnly);
+    if (result == false)
+    {
+        qCritical() << "File open failed:" << recordsFile.errorString();
+        file.close();
+        return false;
+    }
+
+    // Reserve place for the header, it's written with final values on close
+    result = writeHeader(false);
+    return result;
+}
+
+bool ColumnarWriter::resume(const QString &fileName, qint64 packetCount, qint64 valueCount)
+{
+    records.clear();
+    valuesCount = valueCount;
+
+    file.setFileName(fileName);
+    recordsFile.setFileName(fileName + recordsFileSuffix);
+    bool result = file.open(QIODevice::ReadWrite) && recordsFile.open(QIODevice::ReadWrite);
+    if (result == false)
+    {
+        qCritical() << "File open failed:" << file.errorString() << recordsFile.errorString();
+        file.close();
+        recordsFile.close();
+        return false;
+    }
+
+    // Drop everything written after the last committed packet
+    const qint64 valuesEnd = sizeof(ColumnarFileHeader) + valueCount * sizeof(float);
+    const qint64 recordsSize = packetCount * sizeof(ColumnarPacketRecord);
+    if (file.size() < valuesEnd || recordsFile.size() < recordsSize)
+    {
+        qCritical() << "File" << fileName << "is shorter than committed data";
+        file.close();
+        recordsFile.close();
+        return false;
+    }
+
+    result = file.resize(valuesEnd) && recordsFile.resize(recordsSize) &&
+             file.seek(valuesEnd) && recordsFile.seek(0);
+    if (result == true)
+    {
+        records.resize(packetCount);
+        result = (recordsFile.read(reinterpret_cast<char*>(records.data()), recordsSize) == recordsSize);
+    }
+
+    if (result == false)
+    {
+        qCritical() << "File resume failed:" << file.errorString() << recordsFile.errorString();
+        file.close();
+        recordsFile.close();
+    }
+
+    return result;
+}
+
+bool ColumnarWriter::write(const QByteArray &rawData)
+{
+    if (rawData.size() < static_cast<qsizetype>(sizeof(PacketHeader)))
+    {
+        qCritical() << "Data packet size" << rawData.size() << "is too small";
+        return false;
+    }
+
+    PacketHeader packetHeader;
+    memcpy(&packetHeader, rawData.constData(), sizeof(PacketHeader));
+
+    ColumnarPacketRecord record = {};
+    record.startEpochTime = packetHeader.startEpochTime;
+    record.durationMs = packetHeader.durationMs;
+    record.sampleTimeMs = packetHeader.sampleTimeMs;
+    record.dataType = packetHeader.dataType;
+    record.sensorType = packetHeader.sensorType;
+    record.firstValue = valuesCount;
+
+    const char *payload = rawData.constData() + sizeof(PacketHeader);
+    const qsizetype payloadSize = rawData.size() - sizeof(PacketHeader);
+    const char *values = nullptr;
+
+    switch (packetHeader.dataType)
+    {
+    case static_cast<uint8_t>(DataType::Psd):
+    {
+        if (payloadSize < static_cast<qsizetype>(sizeof(PsdHeader)))
+        {
+            qCritical() << "Psd data size" << payloadSize << "is too small";
+            return false;
+        }
+
+        PsdHeader psdHeader;
+        memcpy(&psdHeader, payload, sizeof(PsdHeader));
+        const qsizetype psdPointsSize = payloadSize - sizeof(PsdHeader);
+        if (psdPointsSize != static_cast<qsizetype>(psdHeader.points * sizeof(PsdPoint)))
+        {
+            qCritical() << "Psd points size" << psdPointsSize << "!= points count" << psdHeader.points;
+            return false;
+        }
+
+        record.coreFrequency = psdHeader.coreFrequency;
+        record.coreAmplitude = psdHeader.coreAmplitude;
+        record.deltaFrequency = psdHeader.deltaFrequency;
+        record.valueCount = psdHeader.points;
+        values = payload + sizeof(PsdHeader);
+        break;
+    }
+
+    case static_cast<uint8_t>(DataType::Statistic):
+        if (payloadSize < static_cast<qsizetype>(sizeof(StatisticData)))
+        {
+            qCritical() << "Statistic data size" << payloadSize << "is too small";
+            return false;
+        }
+
+        // Statistic data fields are stored in the declaration order
+        record.valueCount = sizeof(StatisticData) / sizeof(float);
+        values = payload;
+        break;
+
+    default:
+        qCritical() << "Data type" << packetHeader.dataType << "isn't supported by columnar format";
+        return false;
+    }
+
+    // Values are float32 in device byte order (little endian) and copied as is
+    const qint64 valuesSize = record.valueCount * sizeof(float);
+    if (file.write(values, valuesSize) != valuesSize)
+    {
+        qCritical() << "File write failed:" << file.errorString();
+        return false;
+    }
+
+    const qint64 recordSize = sizeof(ColumnarPacketRecord);
+    if (recordsFile.write(reinterpret_cast<const char*>(&record), recordSize) != recordSize)
+    {
+        qCritical() << "File write failed:" << recordsFile.errorString();
+        return false;
+    }
+
+    valuesCount += record.valueCount;
+    records.append(record);
+    return true;
+}
+
+bool ColumnarWriter::flush()
+{
+    return file.flush() && recordsFile.flush();
+}
+
+bool ColumnarWriter::close()
+{
+    if (file.isOpen() == false)
+    {
+        return false;
+    }
+
+    // Align packets table
+    const qint64 padding = (sectionAlignment - file.pos() % sectionAlignment) % sectionAlignment;
+    bool result = (file.write(QByteArray(padding, 0)) == padding);
+
+    const qint64 recordsSize = records.size() * sizeof(ColumnarPacketRecord);
+    if (result == true)
+    {
+        result = (file.write(reinterpret_cast<const char*>(records.constData()), recordsSize) == recordsSize);
+    }
+
+    if (result == true)
+    {
+        result = file.seek(0) && writeHeader(true);
+    }
+
+    if (result == false)
+    {
+        qCritical() << "File write failed:" << file.errorString();
+    }
+
+    file.close();
+
+    // Records are in the file now, side file isn't needed anymore
+    recordsFile.close();
+    if (result == true)
+    {
+        recordsFile.remove();
+    }
+
+    return result;
+}
+
+void ColumnarWriter::suspend()
+{
+    // Leave file incomplete together with the side file, so writing can be resumed later
+    file.close();
+    recordsFile.close();
+}
+
+QString ColumnarWriter::fileName() const
+{
+    return file.fileName();
+}
+
+qint64 ColumnarWriter::packetCount() const
+{
+    return records.size();
+}
+
+qint64 ColumnarWriter::valueCount() const
+{
+    return valuesCount;
+}
+
+bool ColumnarWriter::writeHeader(bool isComplete)
+{
+    ColumnarFileHeader header = {};
+    memcpy(header.magic, ColumnarFileHeader::magicValue, sizeof(header.magic));
+    header.version = ColumnarFileHeader::versionValue;
+    header.headerSize = sizeof(ColumnarFileHeader);
+    header.recordSize = sizeof(ColumnarPacketRecord);
+    header.valuesOffset = sizeof(ColumnarFileHeader);
+    header.valueCount = valuesCount;
+
+    // Packets table is written on close right after aligned values column
+    if (isComplete == true)
+    {
+        const uint64_t valuesEnd = header.valuesOffset + valuesCount * sizeof(float);
+        header.packetsOffset = (valuesEnd + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+        header.packetCount = records.size();
+    }
+
+    return file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+}
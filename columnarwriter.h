@@ -0,0 +1,88 @@
+#ifndef COLUMNARWRITER_H
+#define COLUMNARWRITER_H
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+/**
+ * @brief Binary columnar capture file writer
+ *
+ * File layout, little endian, every section starts at 8 bytes aligned offset:
+ *   ColumnarFileHeader                     at offset 0
+ *   Values column: float32 x valueCount    at ColumnarFileHeader::valuesOffset
+ *   Packets table: ColumnarPacketRecord x packetCount at ColumnarFileHeader::packetsOffset
+ *
+ * Packet values are taken from the values column starting at ColumnarPacketRecord::firstValue:
+ *   PSD - amplitudes of all points, frequency of the point N is N * deltaFrequency
+ *   Statistic - max, min, mean and deviation
+ *
+ * Header is written last, file with zero packetsOffset wasn't closed properly.
+ * While writing, packet records are also appended to the "<file>.records" side file,
+ * which allows to resume writing of not closed file and is removed on close.
+ */
+struct ColumnarFileHeader
+{
+    static constexpr char magicValue[8] = {'P', 'S', 'D', 'C', 'O', 'L', 0, 0};
+    static constexpr uint32_t versionValue = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t reserved;
+    uint64_t packetCount;
+    uint64_t packetsOffset;
+    uint64_t valueCount;
+    uint64_t valuesOffset;
+    uint64_t reserved2;
+};
+
+struct ColumnarPacketRecord
+{
+    // Packet header fields
+    uint32_t startEpochTime;
+    uint32_t durationMs;
+    uint16_t sampleTimeMs;
+    uint8_t dataType;
+    uint8_t sensorType;
+    // PSD header fields, zero for other data types
+    float coreFrequency;
+    float coreAmplitude;
+    float deltaFrequency;
+    uint32_t reserved;
+    // Values of the packet in the values column
+    uint32_t valueCount;
+    uint64_t firstValue;
+};
+
+static_assert(sizeof(ColumnarFileHeader) == 64, "Unexpected columnar file header size");
+static_assert(sizeof(ColumnarPacketRecord) == 40, "Unexpected columnar packet record size");
+
+class ColumnarWriter
+{
+public:
+    bool open(const QString &fileName);
+    bool resume(const QString &fileName, qint64 packetCount, qint64 valueCount);
+    bool write(const QByteArray &rawData);
+    bool flush();
+    bool close();
+    void suspend();
+
+    QString fileName() const;
+    qint64 packetCount() const;
+    qint64 valueCount() const;
+
+private:
+    bool writeHeader(bool isComplete);
+
+    QFile file;
+    QFile recordsFile;
+    QList<ColumnarPacketRecord> records;
+    uint64_t valuesCount = 0;
+};
+
+#endif // COLUMNARWRITER_H
@@ -0,0 +1,136 @@
+#include "commandstats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Smoothing factors and variation multiplier of RFC 6298
+constexpr double latencyGain = 1.0 / 8;
+constexpr double latencyVarGain = 1.0 / 4;
+constexpr double latencyVarFactor = 4;
+}
+
+void CommandStats::addSample(std::chrono::microseconds roundTripTime, std::chrono::microseconds wireTime)
+{
+    const std::chrono::microseconds latency = std::max(roundTripTime - wireTime, std::chrono::microseconds::zero());
+    const double sampleUs = static_cast<double>(latency.count());
+
+    if (sampleCount == 0)
+    {
+        latencyUs = sampleUs;
+        latencyVarUs = sampleUs / 2;
+    }
+    else
+    {
+        latencyVarUs += latencyVarGain * (std::abs(latencyUs - sampleUs) - latencyVarUs);
+        latencyUs += latencyGain * (sampleUs - latencyUs);
+    }
+
+    sampleCount++;
+    latencyMin = std::min(latencyMin, latency);
+    latencyMax = std::max(latencyMax, latency);
+
+    int bucket = 0;
+    for (qint64 ms = latency.count() / 1000; ms > 0 && bucket < histogramSize - 1; ms >>= 1)
+    {
+        bucket++;
+    }
+    latencyHistogram[bucket]++;
+}
+
+void CommandStats::addRetry()
+{
+    retryCount++;
+}
+
+void CommandStats::addTimeout()
+{
+    timeoutCount++;
+}
+
+void CommandStats::addCrcFailure()
+{
+    crcFailureCount++;
+}
+
+std::chrono::milliseconds CommandStats::timeout(std::chrono::microseconds wireTime, std::chrono::milliseconds maxTimeout,
+                                                std::chrono::milliseconds minTimeout) const
+{
+    if (sampleCount == 0)
+    {
+        // Nothing is known about the link yet
+        return maxTimeout;
+    }
+
+    const double timeoutUs = static_cast<double>(wireTime.count()) + latencyUs + latencyVarFactor * latencyVarUs;
+    const auto timeout = std::chrono::milliseconds(static_cast<qint64>(std::ceil(timeoutUs / 1000)));
+
+    return std::clamp(timeout, minTimeout, std::max(maxTimeout, minTimeout));
+}
+
+int CommandStats::samples() const
+{
+    return sampleCount;
+}
+
+int CommandStats::retries() const
+{
+    return retryCount;
+}
+
+int CommandStats::timeouts() const
+{
+    return timeoutCount;
+}
+
+int CommandStats::crcFailures() const
+{
+    return crcFailureCount;
+}
+
+std::chrono::microseconds CommandStats::smoothedLatency() const
+{
+    return std::chrono::microseconds(static_cast<qint64>(latencyUs));
+}
+
+std::chrono::microseconds CommandStats::minLatency() const
+{
+    return sampleCount > 0 ? latencyMin : std::chrono::microseconds::zero();
+}
+
+std::chrono::microseconds CommandStats::maxLatency() const
+{
+    return latencyMax;
+}
+
+const std::array<int, CommandStats::histogramSize> &CommandStats::histogram() const
+{
+    return latencyHistogram;
+}
+
+QString CommandStats::toString() const
+{
+    QString text = QString::number(sampleCount) + " sample(s), latency " +
+                   QString::number(minLatency().count() / 1000.0, 'f', 1) + "/" +
+                   QString::number(latencyUs / 1000, 'f', 1) + "/" +
+                   QString::number(latencyMax.count() / 1000.0, 'f', 1) + " ms (min/avg/max), " +
+                   QString::number(retryCount) + " retries, " +
+                   QString::number(timeoutCount) + " timeouts, " +
+                   QString::number(crcFailureCount) + " CRC failures, histogram";
+
+    for (int bucket = 0; bucket < histogramSize; bucket++)
+    {
+        if (latencyHistogram[bucket] == 0)
+        {
+            continue;
+        }
+
+        QString range = (bucket == 0) ? QString("<1") :
+                        (bucket == histogramSize - 1) ? ">=" + QString::number(1 << (bucket - 1)) :
+                        QString::number(1 << (bucket - 1)) + "-" + QString::number(1 << bucket);
+        text += " " + range + "ms:" + QString::number(latencyHistogram[bucket]);
+    }
+
+    return text;
+}
@@ -0,0 +1,55 @@
+#ifndef COMMANDSTATS_H
+#define COMMANDSTATS_H
+
+#include <array>
+#include <chrono>
+
+#include <QString>
+
+/**
+ * @brief Round trip time statistics of one command type
+ *
+ * Samples are device response latency: measured round trip time without the time of
+ * command and response bytes on the line, so they don't depend on the baud rate and payload size.
+ * Smoothed latency and its variation are estimated as TCP does (RFC 6298).
+ */
+class CommandStats
+{
+public:
+    // Bucket 0 counts latencies below 1 ms, bucket N counts [2^(N-1), 2^N) ms, the last one everything above
+    static constexpr int histogramSize = 14;
+    // Timeout isn't shorter than this to tolerate OS scheduling and USB adapter latency
+    static constexpr std::chrono::milliseconds defaultMinTimeout = std::chrono::milliseconds{100};
+
+    void addSample(std::chrono::microseconds roundTripTime, std::chrono::microseconds wireTime);
+    void addRetry();
+    void addTimeout();
+    void addCrcFailure();
+
+    std::chrono::milliseconds timeout(std::chrono::microseconds wireTime, std::chrono::milliseconds maxTimeout,
+                                      std::chrono::milliseconds minTimeout = defaultMinTimeout) const;
+
+    int samples() const;
+    int retries() const;
+    int timeouts() const;
+    int crcFailures() const;
+    std::chrono::microseconds smoothedLatency() const;
+    std::chrono::microseconds minLatency() const;
+    std::chrono::microseconds maxLatency() const;
+    const std::array<int, histogramSize> &histogram() const;
+
+    QString toString() const;
+
+private:
+    int sampleCount = 0;
+    int retryCount = 0;
+    int timeoutCount = 0;
+    int crcFailureCount = 0;
+    double latencyUs = 0;
+    double latencyVarUs = 0;
+    std::chrono::microseconds latencyMin = std::chrono::microseconds::max();
+    std::chrono::microseconds latencyMax = std::chrono::microseconds::zero();
+    std::array<int, histogramSize> latencyHistogram = {};
+};
+
+#endif // COMMANDSTATS_H
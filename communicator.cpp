@@ -1,15 +1,23 @@
 #include "communicator.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include <QDebug>
+#include <QThread>
+
+#include "crc16.h"
 
 namespace
 {
 constexpr int commandRetryCountMax = 3;
 
 constexpr std::chrono::seconds keepAlivePeriod = std::chrono::seconds{2};
-constexpr std::chrono::seconds ackNoWaitTimeout = std::chrono::seconds{0};
+// Fixed timeouts are used until round trip time is measured and limit the adaptive ones
 constexpr std::chrono::seconds ackWaitShortTimeout = std::chrono::seconds{2};
 constexpr std::chrono::seconds ackWaitLongTimeout = std::chrono::seconds{5};
+// Device searches its archive before answering some commands, so their latency varies far above the measured one
+constexpr std::chrono::milliseconds slowCommandMinTimeout = std::chrono::milliseconds{500};
 
 const char *keepAliveCmd = "!123:KPLV\r";
 const char *downloadRecentCmd = "!123:DWNR=";
@@ -18,33 +26,46 @@ const char *downloadTypeCmd = "!123:DWNT=";
 const char *downloadIdCmd = "!123:DWNI=";
 const char *downloadSizeCmd = "!123:DWNS?\r";
 const char *downloadDataCmd = "!123:DWND?\r";
+const char *logLevelCmd = "!123:LOGL=0\r";
+const char *baudRateCmd = "!123:BAUD=";
+const char *linkTestCmd = "!123:TEST=";
+const char *okResponse = "OK";
+const char *errorResponse = "ERR";
+const char *commandNames[] = {"DWNR", "DWNH", "DWNT", "DWNI", "DWNS", "DWND", "LOGL", "BAUD", "TEST"};
 const char endOfLine = '\r';
+// Baud rates tried by link setup, the highest first
+constexpr int linkBaudRates[] = {921600, 460800, 230400};
+// Test frame is long enough to catch unreliable line at the new rate
+constexpr int linkTestSize = 4096;
+// Device acknowledges new baud rate at the old one and switches after that
+constexpr std::chrono::milliseconds baudSwitchDelay = std::chrono::milliseconds{20};
+// Device returns to the previous baud rate if the new one isn't confirmed in this time
+constexpr std::chrono::milliseconds baudConfirmTimeout = std::chrono::milliseconds{1000};
+// Magic word, CRC and length
+constexpr qint64 binHeaderSize = 8;
 constexpr uint32_t magicPattern = 0xFEDCBA98;
-
-uint16_t crc16_modbus(const QByteArray &data)
-{
-    uint16_t crc = 0xFFFF;
-
-    for (uint8_t byte : data)
-    {
-        crc ^= byte;
-
-        for (int i = 0; i < 8; ++i)
-        {
-            if (crc & 0x0001)
-                crc = (crc >> 1) ^ 0xA001;
-            else
-                crc >>= 1;
-        }
-    }
-
-    return crc;
-}
+// Frame length field is 16 bits, so any frame fits the pool buffer
+constexpr qsizetype frameLengthMax = 0xFFFF;
+// Frames in flight, waiting for delivery and in the processing pipeline queues
+constexpr qsizetype framePoolCapacity = 64;
+// Magic word bytes in the order of receiving (little endian)
+constexpr uint8_t magicBytes[] = {
+    static_cast<uint8_t>(magicPattern & 0xFF),
+    static_cast<uint8_t>((magicPattern >> 8) & 0xFF),
+    static_cast<uint8_t>((magicPattern >> 16) & 0xFF),
+    static_cast<uint8_t>((magicPattern >> 24) & 0xFF),
+};
 }
 
 Communicator::Communicator(SerialPort *serialPort, QObject *parent)
     : QObject{parent}
     , serialPort(serialPort)
+    , keepAliveTimer(this)
+    , ackEventLoop(this)
+    , ackTimer(this)
+    , rxFramePool(frameLengthMax, framePoolCapacity)
+    , pipelineTimer(this)
+    , pipelineEventLoop(this)
 {
     connect(serialPort, &SerialPort::opened, this, &Communicator::onPortOpened);
     connect(serialPort, &SerialPort::closed, this, &Communicator::onPortClosed);
@@ -53,6 +74,19 @@ Communicator::Communicator(SerialPort *serialPort, QObject *parent)
     keepAliveTimer.setSingleShot(true);
     connect(&keepAliveTimer, &QTimer::timeout, this, &Communicator::onKeepAliveTimeout);
 
+    ackTimer.setSingleShot(true);
+    connect(&ackTimer, &QTimer::timeout, this, [=](){
+        if (ackEventLoop.isRunning())
+        {
+            ackEventLoop.exit(static_cast<int>(AckResult::Timeout));
+        }
+    });
+
+    pipelineTimer.setSingleShot(true);
+    connect(&pipelineTimer, &QTimer::timeout, this, &Communicator::onPipelineTimeout);
+
+    clock.start();
+
     connect(this, &Communicator::ackReceived, this, [=](){
         if (ackEventLoop.isRunning())
         {
@@ -65,6 +99,128 @@ Communicator::~Communicator()
 {
 }
 
+double Communicator::lineRate()
+{
+    // Every byte takes 10 bits on the line: start bit, 8 data bits and stop bit
+    return serialPort->baudRate() / 10.0;
+}
+
+CommandStats Communicator::commandStats(Command command) const
+{
+    return stats[static_cast<int>(command)];
+}
+
+QString Communicator::commandName(Command command)
+{
+    return commandNames[static_cast<int>(command)];
+}
+
+Communicator::SessionCounters Communicator::sessionCounters() const
+{
+    return session;
+}
+
+SerialPort::TxStats Communicator::txStats() const
+{
+    return serialPort->txStats();
+}
+
+QString Communicator::txStatsText() const
+{
+    return serialPort->txStatsText();
+}
+
+QString Communicator::statsText() const
+{
+    QString text;
+    for (int command = 0; command < static_cast<int>(Command::Count); command++)
+    {
+        const CommandStats &commandStats = stats[command];
+        if (commandStats.samples() == 0 && commandStats.retries() == 0)
+        {
+            continue;
+        }
+
+        if (text.isEmpty() == false)
+        {
+            text += "; ";
+        }
+        text += QString(commandNames[command]) + ": " + commandStats.toString();
+    }
+
+    return text;
+}
+
+void Communicator::resetSessionCounters()
+{
+    session = SessionCounters();
+    serialPort->resetTxStats();
+    serialPort->resetReadAllocations();
+    rxCorruptedFrames = 0;
+    rxDiscardedBytes = 0;
+    rxFramePool.resetStats();
+}
+
+BufferPool &Communicator::framePool()
+{
+    return rxFramePool;
+}
+
+qint64 Communicator::corruptedFrames() const
+{
+    return rxCorruptedFrames;
+}
+
+qint64 Communicator::discardedBytes() const
+{
+    return rxDiscardedBytes;
+}
+
+qint64 Communicator::readAllocations() const
+{
+    return serialPort->readAllocations();
+}
+
+bool Communicator::setupLink(int maxBaudRate)
+{
+    const int initialBaudRate = serialPort->baudRate();
+    qInfo() << "Link setup at" << initialBaudRate << "baud, up to" << maxBaudRate << "baud";
+
+    // Device log messages interfere with responses
+    bool result = sendCommand(Command::LogLevel, logLevelCmd);
+    if (result == false)
+    {
+        // Device keeps the negotiated rate if the previous session wasn't closed properly
+        result = findBaudRate() && restoreBaudRate();
+    }
+    if (result == false)
+    {
+        qCritical() << "Disable device logging failed";
+        emit linkReady(false, serialPort->baudRate());
+        return false;
+    }
+
+    for (int baudRate : linkBaudRates)
+    {
+        if (baudRate > maxBaudRate || baudRate <= initialBaudRate)
+        {
+            continue;
+        }
+
+        result = switchBaudRate(baudRate, initialBaudRate);
+        if (result == true)
+        {
+            break;
+        }
+    }
+
+    const int baudRate = serialPort->baudRate();
+    qInfo() << "Link ready at" << baudRate << "baud";
+    emit linkReady(true, baudRate);
+
+    return true;
+}
+
 bool Communicator::setDownloadRecent(int startId, int endId)
 {
     QString data = downloadRecentCmd;
@@ -73,7 +229,7 @@ bool Communicator::setDownloadRecent(int startId, int endId)
     data += QString::number(endId);
     data += endOfLine;
 
-    bool result = sendCommand(data.toUtf8(), ackWaitShortTimeout);
+    bool result = sendCommand(Command::DownloadRecent, data.toUtf8());
     return result;
 }
 
@@ -87,7 +243,7 @@ bool Communicator::setDownloadHistoric(time_t startTime, int startId, int endId)
     data += QString::number(endId);
     data += endOfLine;
 
-    bool result = sendCommand(data.toUtf8(), ackWaitShortTimeout);
+    bool result = sendCommand(Command::DownloadHistoric, data.toUtf8());
     return result;
 }
 
@@ -99,7 +255,7 @@ bool Communicator::setDownloadType(int sensorType, int dataType)
     data += QString::number(dataType);
     data += endOfLine;
 
-    bool result = sendCommand(data.toUtf8(), ackWaitShortTimeout);
+    bool result = sendCommand(Command::DownloadType, data.toUtf8());
     return result;
 }
 
@@ -109,13 +265,13 @@ bool Communicator::setDownloadId(int id)
     data += QString::number(id);
     data += endOfLine;
 
-    bool result = sendCommand(data.toUtf8(), ackWaitShortTimeout);
+    bool result = sendCommand(Command::DownloadId, data.toUtf8());
     return result;
 }
 
 bool Communicator::getDownloadSize(int &size)
 {
-    bool result = sendCommand(downloadSizeCmd, ackWaitLongTimeout);
+    bool result = sendCommand(Command::DownloadSize, downloadSizeCmd);
     if (result == true)
     {
         if (rxTextData.length() > 0)
@@ -133,13 +289,13 @@ bool Communicator::getDownloadSize(int &size)
 
 bool Communicator::getDownloadData(int &packetId, QByteArray &data)
 {
-    bool result = sendCommand(downloadDataCmd, ackWaitLongTimeout, true);
+    bool result = sendCommand(Command::DownloadData, downloadDataCmd, true);
     if (result == true)
     {
         if (rxTextData.length() > 0 && rxBinData.size() > 0)
         {
             packetId = rxTextData.toInt();
-            data = rxBinData;
+            data = std::move(rxBinData);
         }
         else
         {
@@ -150,8 +306,116 @@ bool Communicator::getDownloadData(int &packetId, QByteArray &data)
     return result;
 }
 
+bool Communicator::getDownloadDataPipelined(int startId, int endId, int window, const PacketHandler &handler)
+{
+    if (sendState == SendState::InProgress)
+    {
+        qWarning() << "Command sending is in progress";
+        return false;
+    }
+
+    sendState = SendState::InProgress;
+
+    pipelineState = PipelineState::Running;
+    pipelineWindow = std::max(window, 1);
+    pipelineNextId = startId;
+    pipelineEndId = endId;
+    pipelineDeliverId = startId;
+    pipelineRequested.clear();
+    pipelineReceived.clear();
+    pipelineRetries.clear();
+    pipelineSentNs.clear();
+    pipelineProgressNs = clock.nsecsElapsed();
+    pipelineCorruptedId = -1;
+
+    // Only binary frames are expected, text acks of the packet id requests are skipped while waiting for magic word
+    resetRxState(true);
+
+    while (pipelineState == PipelineState::Running || pipelineState == PipelineState::Draining)
+    {
+        // Deliver received packets in id order, handler is called outside of RX processing
+        while (pipelineState == PipelineState::Running && pipelineReceived.contains(pipelineDeliverId))
+        {
+            // Frame buffer is handed over to the handler without copying
+            bool proceed = handler(pipelineDeliverId, pipelineReceived.take(pipelineDeliverId));
+            pipelineDeliverId++;
+            if (proceed == false)
+            {
+                qDebug() << "Pipeline draining," << pipelineRequested.size() << "request(s) in flight";
+                pipelineState = PipelineState::Draining;
+                pipelineTimer.start(ackWaitShortTimeout);
+            }
+        }
+
+        if (pipelineState == PipelineState::Running)
+        {
+            // Keep the window of requests in flight, nothing is requested past the end
+            while (pipelineNextId < pipelineEndId && pipelineRequested.size() + pipelineReceived.size() < pipelineWindow)
+            {
+                bool result = requestPipelinePacket(pipelineNextId);
+                if (result == false)
+                {
+                    pipelineState = PipelineState::Failed;
+                    break;
+                }
+                pipelineNextId++;
+            }
+
+            if (pipelineState == PipelineState::Running && pipelineNextId >= pipelineEndId && pipelineRequested.isEmpty())
+            {
+                // Every packet up to the end is delivered, or the device has no more packets
+                pipelineState = PipelineState::Finished;
+            }
+        }
+        else if (pipelineState == PipelineState::Draining && pipelineRequested.isEmpty())
+        {
+            pipelineState = PipelineState::Finished;
+        }
+
+        if (pipelineState == PipelineState::Running || pipelineState == PipelineState::Draining)
+        {
+            // Wait for the next packet, timeout or error
+            int code = pipelineEventLoop.exec();
+            if (code < 0 || QThread::currentThread()->isInterruptionRequested())
+            {
+                // Event loop isn't able to run, I/O thread is quitting
+                pipelineState = PipelineState::Failed;
+            }
+        }
+    }
+
+    bool result = (pipelineState == PipelineState::Finished);
+
+    pipelineTimer.stop();
+    pipelineState = PipelineState::None;
+    pipelineRequested.clear();
+    pipelineReceived.clear();
+    pipelineRetries.clear();
+    pipelineSentNs.clear();
+
+    rxState = RxState::WaitEndLine;
+    ackState = AckState::None;
+    sendState = SendState::None;
+
+    return result;
+}
+
+void Communicator::closeLink()
+{
+    if (serialPort->isOpened() == false)
+    {
+        return;
+    }
+
+    // Next session finds the device at the rate the port is opened with
+    restoreBaudRate();
+    serialPort->close();
+}
+
 void Communicator::onPortOpened()
 {
+    defaultBaudRate = serialPort->baudRate();
+    keepAliveAcksPending = 0;
     // Send first keep alive message to the device
     sendKeepAlive();
     // Start keep alive timer
@@ -161,27 +425,81 @@ void Communicator::onPortOpened()
 void Communicator::onPortClosed()
 {
     keepAliveTimer.stop();
+    ackTimer.stop();
     if (ackEventLoop.isRunning())
     {
         ackEventLoop.exit(static_cast<int>(AckResult::Error));
     }
+
+    if (pipelineState == PipelineState::Running || pipelineState == PipelineState::Draining)
+    {
+        finishPipeline(PipelineState::Failed);
+    }
 }
 
-void Communicator::onPortRead(QByteArray data)
+void Communicator::onPortRead(const QByteArray &data)
 {
-    // Restart keep alive on RX (no keep alive while device is sending data)
-    keepAliveTimer.start(keepAlivePeriod);
+    rxByteCount += data.size();
+    session.rxBytes += data.size();
 
-    for (uint8_t byte : data)
+    // No keep alive while device is sending data, ack timeout is counted from the last received byte
+    lastActivityNs = clock.nsecsElapsed();
+    if (ackEventLoop.isRunning())
     {
+        ackTimer.start(ackTimeout);
+    }
+
+    if (pipelineState == PipelineState::Running || pipelineState == PipelineState::Draining)
+    {
+        // Device is still sending, restart pipeline timeout
+        pipelineTimer.start(pipelineState == PipelineState::Running ? pipelineTimeout() : ackWaitShortTimeout);
+    }
+
+    const char *bytes = data.constData();
+    const qsizetype size = data.size();
+    qsizetype pos = 0;
+
+    while (pos < size)
+    {
+        const uint8_t byte = static_cast<uint8_t>(bytes[pos]);
+
         switch (rxState)
         {
         case RxState::WaitBinMagic:
-            rxBinHeader.magic >>= 8;
-            rxBinHeader.magic |= (byte << 24);
-            if (rxBinHeader.magic == magicPattern)
+            if (rxMagicMatched == 0)
+            {
+                // Jump to the first magic byte candidate instead of shifting every byte
+                const void *found = memchr(bytes + pos, magicBytes[0], size - pos);
+                const qsizetype end = (found != nullptr) ? static_cast<const char*>(found) - bytes : size;
+                if (pipelineState == PipelineState::None)
+                {
+                    // Only the frame is expected, in pipelined mode acks of packet id requests are skipped here as well
+                    rxDiscardedBytes += end - pos;
+                }
+                onSkippedText(bytes + pos, end - pos);
+                if (found == nullptr)
+                {
+                    pos = size;
+                    break;
+                }
+                pos = end + 1;
+                rxMagicMatched = 1;
+            }
+            else
+            {
+                // Magic bytes are all different, so mismatch can only restart the match from the first byte
+                if (byte == magicBytes[rxMagicMatched])
+                    rxMagicMatched++;
+                else
+                    rxMagicMatched = (byte == magicBytes[0]) ? 1 : 0;
+                pos++;
+            }
+
+            if (rxMagicMatched == sizeof(magicBytes))
             {
                 qDebug() << "Magic word found";
+                rxBinHeader.magic = magicPattern;
+                rxMagicMatched = 0;
                 rxState = RxState::WaitBinCrcLsb;
             }
             break;
@@ -189,100 +507,215 @@ void Communicator::onPortRead(QByteArray data)
         case RxState::WaitBinCrcLsb:
             rxBinHeader.crc16 = byte;
             rxState = RxState::WaitBinCrcMsb;
+            pos++;
             break;
 
         case RxState::WaitBinCrcMsb:
             rxBinHeader.crc16 |= byte << 8;
             rxState = RxState::WaitBinLengthLsb;
+            pos++;
             break;
 
         case RxState::WaitBinLengthLsb:
             rxBinHeader.length = byte;
             rxState = RxState::WaitBinLengthMsb;
+            pos++;
             break;
 
         case RxState::WaitBinLengthMsb:
             rxBinHeader.length |= byte << 8;
             qDebug() << "Wait BIN data:" << rxBinHeader.length << "bytes";
             rxState = RxState::WaitBinData;
-            rxBinData.clear();
+            // Frame is received straight to the pooled buffer, which is handed over to the consumer as is
+            rxFramePool.release(rxBinData);
+            rxBinData = rxFramePool.acquire();
+            rxBinCrc = Crc16::initValue;
+            pos++;
             break;
 
         case RxState::WaitBinData:
-            rxBinData += byte;
+        {
+            // Copy all available bytes of the frame at once and fold CRC over them
+            const qsizetype count = std::min<qsizetype>(rxBinHeader.length - rxBinData.size(), size - pos);
+            rxBinData.append(bytes + pos, count);
+            rxBinCrc = Crc16::update(rxBinCrc, bytes + pos, count);
+            pos += count;
+
             if (rxBinData.size() >= rxBinHeader.length)
             {
-                uint16_t crc16 = crc16_modbus(rxBinData);
-                if (crc16 == rxBinHeader.crc16)
+                if (rxBinCrc == rxBinHeader.crc16)
                 {
                     qDebug() << "Received BIN data:" << rxBinHeader.length << "bytes";
                     emit binDataReceived(rxBinData);
                 }
                 else
                 {
-                    rxBinData.clear();
+                    qWarning() << "BIN data CRC failed";
+                    if (pipelineState != PipelineState::None)
+                    {
+                        onPipelineCorruptedFrame();
+                    }
+                    else
+                    {
+                        onCorruptedFrame();
+                    }
                 }
                 rxState = RxState::WaitEndLine;
             }
             break;
+        }
 
         case RxState::WaitEndLine:
-            if (byte == endOfLine)
+        {
+            // Take all text bytes up to the end of line at once
+            const void *found = memchr(bytes + pos, endOfLine, size - pos);
+            const qsizetype end = (found != nullptr) ? static_cast<const char*>(found) - bytes : size;
+            if (ackState == AckState::WaitRx)
+            {
+                rxTextData += QLatin1String(bytes + pos, end - pos);
+            }
+            pos = end;
+            if (found == nullptr)
+            {
+                break;
+            }
+            pos++;
+
+            if (keepAliveAcksPending > 0 && pipelineState == PipelineState::None)
+            {
+                // Device answers in order, so the line is the response to the keep alive sent before the command
+                keepAliveAcksPending--;
+                rxTextData.clear();
+            }
+            else if (pipelineState != PipelineState::None)
             {
-                if (ackState == AckState::WaitRx)
+                // Packet id follows the binary frame in pipelined mode
+                bool isNumber = false;
+                int packetId = rxTextData.toInt(&isNumber);
+                if (isNumber == true && packetId == pipelineCorruptedId)
                 {
-                    if (rxTextData.length() > 0)
-                    {
-                        qDebug() << "Received TEXT data:" << rxTextData;
-                        emit textDataReceived(rxTextData);
-                    }
-                    ackState = AckState::Received;
-                    qDebug() << "Ack received";
-                    emit ackReceived();
+                    qDebug() << "Packet" << packetId << "is already requested again";
                 }
+                else if (isNumber == true)
+                {
+                    onPipelinePacket(packetId, rxBinData.isEmpty() == false);
+                }
+                else
+                {
+                    qWarning() << "Unexpected packet id:" << rxTextData;
+                }
+                rxTextData.clear();
+                rxFramePool.release(rxBinData);
+                rxMagicMatched = 0;
+                pipelineCorruptedId = -1;
+                rxState = RxState::WaitBinMagic;
             }
-            else
+            else if (ackState == AckState::WaitRx)
             {
-                if (ackState == AckState::WaitRx)
+                if (rxTextData.length() > 0)
                 {
-                    rxTextData += (char)byte;
+                    qDebug() << "Received TEXT data:" << rxTextData;
+                    emit textDataReceived(rxTextData);
                 }
+                ackState = AckState::Received;
+                qDebug() << "Ack received";
+                emit ackReceived();
             }
             break;
+        }
 
         default:
+            pos++;
             break;
         }
-
     }
 }
 
 void Communicator::onKeepAliveTimeout()
 {
+    if (sendState == SendState::InProgress)
+    {
+        // Commands of the transaction keep the link alive, keep alive would only share the line with them
+        session.keepAlivesSuppressed++;
+        keepAliveTimer.start(keepAlivePeriod);
+        return;
+    }
+
+    const auto idleTime = std::chrono::nanoseconds(clock.nsecsElapsed() - lastActivityNs);
+    if (idleTime < keepAlivePeriod)
+    {
+        // Line was busy recently, wait for the rest of the period
+        session.keepAlivesDeferred++;
+        keepAliveTimer.start(std::chrono::ceil<std::chrono::milliseconds>(keepAlivePeriod - idleTime));
+        return;
+    }
+
     // Send next keep alive message to the device
     sendKeepAlive();
     // Restart keep alive timer
     keepAliveTimer.start(keepAlivePeriod);
 }
 
+void Communicator::onPipelineTimeout()
+{
+    if (pipelineState == PipelineState::Running)
+    {
+        qWarning() << "Pipeline timeout," << pipelineRequested.size() << "packet(s) missing";
+        stats[static_cast<int>(Command::DownloadData)].addTimeout();
+
+        // Nothing is received for the requests in flight, request them again
+        const QList<int> missingIds = pipelineRequested;
+        pipelineRequested.clear();
+        for (int id : missingIds)
+        {
+            bool result = retryPipelinePacket(id);
+            if (result == false)
+            {
+                break;
+            }
+        }
+
+        if (pipelineEventLoop.isRunning())
+        {
+            pipelineEventLoop.exit();
+        }
+    }
+    else if (pipelineState == PipelineState::Draining)
+    {
+        qWarning() << "Pipeline drain timeout," << pipelineRequested.size() << "request(s) dropped";
+        finishPipeline(PipelineState::Finished);
+    }
+}
+
 void Communicator::resetRxState(bool waitBinData)
 {
     rxState = waitBinData ? RxState::WaitBinMagic : RxState::WaitEndLine;
     ackState = AckState::WaitRx;
     rxTextData.clear();
+    skippedLine.clear();
+    rxMagicMatched = 0;
 }
 
 void Communicator::sendKeepAlive()
 {
-    bool result = serialPort->write(keepAliveCmd);
-    if (result == true && ackEventLoop.isRunning())
+    // Device acks the keep alive, the response is dropped to not end the ack wait of the next command
+    bool result = serialPort->write(keepAliveCmd, SerialPort::Priority::KeepAlive);
+    if (result == true)
     {
-        // Ack timeout due to keep alive sending after specified time
-        ackEventLoop.exit(static_cast<int>(AckResult::Timeout));
+        onWritten(strlen(keepAliveCmd));
+        session.keepAlives++;
+        keepAliveAcksPending++;
     }
 }
 
-bool Communicator::sendCommand(const QByteArray &data, std::chrono::milliseconds timeout, bool waitBinData)
+void Communicator::onWritten(qint64 bytes)
+{
+    // Any command proves the link is alive
+    session.txBytes += bytes;
+    lastActivityNs = clock.nsecsElapsed();
+}
+
+bool Communicator::sendCommand(Command command, const QByteArray &data, bool waitBinData)
 {
     if (sendState == SendState::InProgress)
     {
@@ -292,12 +725,26 @@ bool Communicator::sendCommand(const QByteArray &data, std::chrono::milliseconds
 
     sendState = SendState::InProgress;
 
+    CommandStats &commandStats = stats[static_cast<int>(command)];
+    const bool isLongResponse = (command == Command::DownloadSize || command == Command::DownloadData ||
+                                 command == Command::LinkTest);
+    const std::chrono::milliseconds maxTimeout = isLongResponse ? ackWaitLongTimeout : ackWaitShortTimeout;
+    const bool isSlowCommand = (command == Command::DownloadHistoric || command == Command::DownloadSize);
+    const std::chrono::milliseconds minTimeout = isSlowCommand ? slowCommandMinTimeout : CommandStats::defaultMinTimeout;
+
     bool result = false;
     int retryCount = 0;
     while (result == false && retryCount < commandRetryCountMax)
     {
+        if (retryCount > 0)
+        {
+            commandStats.addRetry();
+        }
+
         // Reset RX states before sending the request to get valid response
         resetRxState(waitBinData);
+        const qint64 sentByteCount = rxByteCount;
+        const qint64 sentNs = clock.nsecsElapsed();
 
         result = serialPort->write(data);
         if (result == false)
@@ -305,20 +752,37 @@ bool Communicator::sendCommand(const QByteArray &data, std::chrono::milliseconds
             qCritical() << "Command write failed";
             break;
         }
+        onWritten(data.size());
 
-        if (timeout > ackNoWaitTimeout)
+        // Wait for the measured device latency plus time of the command and expected response on the line,
+        // every retry waits twice as long as the previous attempt up to the command limit (RFC 6298 backoff)
+        const qint64 expectedBytes = data.size() + responseBytes[static_cast<int>(command)];
+        const std::chrono::milliseconds timeout = commandStats.timeout(wireTime(expectedBytes), maxTimeout, minTimeout);
+        AckResult ackResult = waitForAck(std::min(timeout * (1 << retryCount), std::max(timeout, maxTimeout)));
+        result = (ackResult == AckResult::Ok);
+        if (ackResult == AckResult::Ok)
         {
-            AckResult ackResult = waitForAck(timeout);
-            result = (ackResult == AckResult::Ok);
-            if (ackResult == AckResult::Timeout)
-            {
-                qWarning() << "Ack timeout";
-            }
-            else if (ackResult == AckResult::Error)
-            {
-                qCritical() << "Ack error";
-                break;
-            }
+            const qint64 receivedBytes = rxByteCount - sentByteCount;
+            const auto roundTripTime = std::chrono::microseconds((clock.nsecsElapsed() - sentNs) / 1000);
+            commandStats.addSample(roundTripTime, wireTime(data.size() + receivedBytes));
+            responseBytes[static_cast<int>(command)] = receivedBytes;
+        }
+        else if (ackResult == AckResult::Timeout)
+        {
+            qWarning() << "Ack timeout after" << ackTimeout;
+            commandStats.addTimeout();
+            // Line is quiet, responses to earlier keep alives are lost
+            keepAliveAcksPending = 0;
+        }
+        else if (ackResult == AckResult::CrcError)
+        {
+            qWarning() << "Response CRC failed, retry";
+            commandStats.addCrcFailure();
+        }
+        else if (ackResult == AckResult::Error)
+        {
+            qCritical() << "Ack error";
+            break;
         }
         retryCount++;
     }
@@ -330,12 +794,372 @@ bool Communicator::sendCommand(const QByteArray &data, std::chrono::milliseconds
 
 Communicator::AckResult Communicator::waitForAck(std::chrono::milliseconds timeout)
 {
-    assert(timeout > ackNoWaitTimeout);
+    assert(timeout > std::chrono::milliseconds::zero());
 
-    // Restart keep alive for specified timeout (will be restarted on RX as well)
-    keepAliveTimer.start(timeout);
+    // Ack timer is restarted on RX as well
+    ackTimeout = timeout;
+    ackTimer.start(timeout);
 
     int code = ackEventLoop.exec();
+    ackTimer.stop();
+    if (code < 0 || QThread::currentThread()->isInterruptionRequested())
+    {
+        // Event loop isn't able to run, I/O thread is quitting
+        return AckResult::Error;
+    }
 
     return static_cast<AckResult>(code);
 }
+
+bool Communicator::switchBaudRate(int baudRate, int fallbackBaudRate)
+{
+    // Adapter support is checked before the device is switched
+    bool result = serialPort->setBaudRate(baudRate);
+    serialPort->setBaudRate(fallbackBaudRate);
+    if (result == false)
+    {
+        return false;
+    }
+
+    qInfo() << "Try" << baudRate << "baud";
+    const bool isSwitched = sendBaudRate(baudRate);
+    result = isSwitched;
+    if (result == true)
+    {
+        delay(baudSwitchDelay);
+        serialPort->setBaudRate(baudRate);
+
+        // Device keeps the new rate only if the same command confirms it after successful test
+        result = testLink();
+        if (result == true)
+        {
+            result = sendBaudRate(baudRate);
+        }
+    }
+
+    if (result == false)
+    {
+        qWarning() << "Link at" << baudRate << "baud failed, fall back to" << fallbackBaudRate << "baud";
+        serialPort->setBaudRate(fallbackBaudRate);
+
+        if (isSwitched == true)
+        {
+            // Wait until the device returns to the previous rate as well
+            delay(baudConfirmTimeout + baudSwitchDelay);
+        }
+    }
+
+    return result;
+}
+
+bool Communicator::sendBaudRate(int baudRate)
+{
+    QByteArray data = baudRateCmd;
+    data += QByteArray::number(baudRate);
+    data += endOfLine;
+
+    bool result = sendCommand(Command::BaudRate, data);
+    if (result == true && rxTextData != okResponse)
+    {
+        // Device answers an unsupported rate with error and stays at its rate
+        qWarning() << "Device refused" << baudRate << "baud:" << rxTextData;
+        result = false;
+    }
+
+    return result;
+}
+
+bool Communicator::restoreBaudRate()
+{
+    const int baudRate = serialPort->baudRate();
+    if (baudRate == defaultBaudRate)
+    {
+        return true;
+    }
+
+    qInfo() << "Restore" << defaultBaudRate << "baud";
+    bool result = sendBaudRate(defaultBaudRate);
+    if (result == true)
+    {
+        delay(baudSwitchDelay);
+        serialPort->setBaudRate(defaultBaudRate);
+
+        // Default rate is known to work, it's confirmed without the test
+        result = sendBaudRate(defaultBaudRate);
+        if (result == false)
+        {
+            // Device returns to the previous rate without confirmation
+            serialPort->setBaudRate(baudRate);
+            delay(baudConfirmTimeout + baudSwitchDelay);
+        }
+    }
+
+    if (result == false)
+    {
+        qWarning() << "Restore" << defaultBaudRate << "baud failed, device stays at" << baudRate << "baud";
+    }
+
+    return result;
+}
+
+bool Communicator::findBaudRate()
+{
+    for (int baudRate : linkBaudRates)
+    {
+        // Rates not supported by the adapter couldn't be negotiated before
+        if (baudRate == defaultBaudRate || serialPort->setBaudRate(baudRate) == false)
+        {
+            continue;
+        }
+
+        qInfo() << "Look for the device at" << baudRate << "baud";
+        bool result = sendCommand(Command::LogLevel, logLevelCmd);
+        if (result == true)
+        {
+            qInfo() << "Device found at" << baudRate << "baud";
+            return true;
+        }
+    }
+
+    serialPort->setBaudRate(defaultBaudRate);
+    return false;
+}
+
+bool Communicator::testLink()
+{
+    const CommandStats &testStats = stats[static_cast<int>(Command::LinkTest)];
+    const int crcFailures = testStats.crcFailures();
+
+    QByteArray data = linkTestCmd;
+    data += QByteArray::number(linkTestSize);
+    data += endOfLine;
+
+    bool result = sendCommand(Command::LinkTest, data, true);
+    if (result == true)
+    {
+        // Any damaged frame means the rate isn't reliable, even if the retry passed
+        result = (testStats.crcFailures() == crcFailures && rxBinData.size() == linkTestSize &&
+                  rxTextData.toInt() == linkTestSize);
+    }
+    rxFramePool.release(rxBinData);
+
+    if (result == false)
+    {
+        qWarning() << "Link test failed";
+    }
+
+    return result;
+}
+
+void Communicator::delay(std::chrono::milliseconds time)
+{
+    QEventLoop loop;
+    QTimer::singleShot(time, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+bool Communicator::requestPipelinePacket(int id)
+{
+    // Packet id selection and data request are sent together without waiting for ack
+    QByteArray data = downloadIdCmd;
+    data += QByteArray::number(id);
+    data += endOfLine;
+    data += downloadDataCmd;
+
+    bool result = serialPort->write(data);
+    if (result == true)
+    {
+        onWritten(data.size());
+        pipelineRequested.append(id);
+        pipelineSentNs.insert(id, clock.nsecsElapsed());
+        pipelineTimer.start(pipelineTimeout());
+    }
+    else
+    {
+        qCritical() << "Packet" << id << "request failed";
+    }
+
+    return result;
+}
+
+bool Communicator::retryPipelinePacket(int id)
+{
+    int retryCount = ++pipelineRetries[id];
+    if (retryCount >= commandRetryCountMax)
+    {
+        qCritical() << "Packet" << id << "retries exceeded";
+        finishPipeline(PipelineState::Failed);
+        return false;
+    }
+
+    qWarning() << "Packet" << id << "is missing, retry" << retryCount;
+    stats[static_cast<int>(Command::DownloadData)].addRetry();
+
+    bool result = requestPipelinePacket(id);
+    if (result == false)
+    {
+        finishPipeline(PipelineState::Failed);
+    }
+
+    return result;
+}
+
+void Communicator::onPipelinePacket(int packetId, bool isValid)
+{
+    int index = pipelineRequested.indexOf(packetId);
+    if (index < 0)
+    {
+        qWarning() << "Packet" << packetId << "wasn't requested";
+        return;
+    }
+
+    // Device handles requests in order, so the ones sent before this packet were lost
+    QList<int> missingIds = pipelineRequested.first(index);
+    pipelineRequested.remove(0, index + 1);
+
+    CommandStats &commandStats = stats[static_cast<int>(Command::DownloadData)];
+    const qint64 nowNs = clock.nsecsElapsed();
+    if (isValid == true)
+    {
+        qDebug() << "Packet" << packetId << "received," << pipelineRequested.size() << "request(s) in flight";
+        const qint64 receivedBytes = binHeaderSize + rxBinData.size() + rxTextData.size() + 1;
+        pipelineReceived.insert(packetId, std::move(rxBinData));
+
+        // Responses are queued on the line, so the packet is waited for since the previous one arrived
+        const qint64 startNs = std::max(pipelineSentNs.value(packetId, nowNs), pipelineProgressNs);
+        commandStats.addSample(std::chrono::microseconds((nowNs - startNs) / 1000), wireTime(receivedBytes));
+        responseBytes[static_cast<int>(Command::DownloadData)] = receivedBytes;
+    }
+    else
+    {
+        qWarning() << "Packet" << packetId << "is corrupted";
+        missingIds.append(packetId);
+    }
+    pipelineSentNs.remove(packetId);
+    pipelineProgressNs = nowNs;
+
+    if (pipelineState == PipelineState::Running)
+    {
+        // Request only missing packets again
+        for (int id : missingIds)
+        {
+            bool result = retryPipelinePacket(id);
+            if (result == false)
+            {
+                break;
+            }
+        }
+    }
+
+    if (pipelineEventLoop.isRunning())
+    {
+        pipelineEventLoop.exit();
+    }
+}
+
+void Communicator::onPipelineCorruptedFrame()
+{
+    const qint64 frameBytes = binHeaderSize + rxBinData.size();
+    rxCorruptedFrames++;
+    rxDiscardedBytes += frameBytes;
+    rxFramePool.release(rxBinData);
+    stats[static_cast<int>(Command::DownloadData)].addCrcFailure();
+
+    if (pipelineState != PipelineState::Running || pipelineRequested.isEmpty())
+    {
+        return;
+    }
+
+    // Device answers requests in order, so the frame belongs to the oldest request in flight,
+    // request it again without waiting for the packet id line
+    const int packetId = pipelineRequested.takeFirst();
+    pipelineSentNs.remove(packetId);
+    pipelineCorruptedId = packetId;
+    retryPipelinePacket(packetId);
+}
+
+void Communicator::onSkippedText(const char *data, qsizetype size)
+{
+    // Only short ack and error lines are skipped between frames
+    for (qsizetype pos = 0; pos < size; pos++)
+    {
+        if (data[pos] == endOfLine)
+        {
+            if (keepAliveAcksPending > 0)
+            {
+                // Responses to keep alives sent before the request come first
+                keepAliveAcksPending--;
+            }
+            else if (pipelineState != PipelineState::None && skippedLine == errorResponse)
+            {
+                onPipelineError();
+            }
+            skippedLine.clear();
+        }
+        else if (skippedLine.size() < 8)
+        {
+            skippedLine.append(data[pos]);
+        }
+    }
+}
+
+void Communicator::onPipelineError()
+{
+    if (pipelineRequested.isEmpty())
+    {
+        qWarning() << "Unexpected error response";
+        return;
+    }
+
+    // Device answers requests in order, so the error is the response to the oldest request in flight
+    const int packetId = pipelineRequested.takeFirst();
+    pipelineSentNs.remove(packetId);
+    pipelineProgressNs = clock.nsecsElapsed();
+    qWarning() << "Packet" << packetId << "isn't available on the device";
+
+    // Packets after it aren't available either
+    pipelineEndId = std::min(pipelineEndId, packetId);
+
+    if (pipelineEventLoop.isRunning())
+    {
+        pipelineEventLoop.exit();
+    }
+}
+
+void Communicator::onCorruptedFrame()
+{
+    const qint64 frameBytes = binHeaderSize + rxBinData.size();
+    rxCorruptedFrames++;
+    rxDiscardedBytes += frameBytes;
+    rxFramePool.release(rxBinData);
+
+    if (ackState == AckState::WaitRx && ackEventLoop.isRunning())
+    {
+        // Don't wait for the rest of the response, request it again right away
+        ackState = AckState::None;
+        ackEventLoop.exit(static_cast<int>(AckResult::CrcError));
+    }
+}
+
+void Communicator::finishPipeline(PipelineState state)
+{
+    pipelineTimer.stop();
+    pipelineState = state;
+    if (pipelineEventLoop.isRunning())
+    {
+        pipelineEventLoop.exit();
+    }
+}
+
+std::chrono::milliseconds Communicator::pipelineTimeout()
+{
+    // Pipeline makes progress with every packet, so one packet response is waited for
+    const qint64 expectedBytes = strlen(downloadIdCmd) + strlen(downloadDataCmd) + responseBytes[static_cast<int>(Command::DownloadData)];
+    return stats[static_cast<int>(Command::DownloadData)].timeout(wireTime(expectedBytes), ackWaitLongTimeout);
+}
+
+std::chrono::microseconds Communicator::wireTime(qint64 bytes)
+{
+    const double rate = lineRate();
+    return std::chrono::microseconds(rate > 0 ? static_cast<qint64>(bytes * 1000000 / rate) : 0);
+}
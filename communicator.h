@@ -1,11 +1,20 @@
 #ifndef COMMUNICATOR_H
 #define COMMUNICATOR_H
 
+#include <array>
+#include <functional>
+
 #include <QByteArray>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHash>
+#include <QList>
 #include <QObject>
 #include <QString>
 #include <QTimer>
 
+#include "bufferpool.h"
+#include "commandstats.h"
 #include "serialport.h"
 
 class Communicator : public QObject
@@ -32,6 +41,7 @@ class Communicator : public QObject
     {
         Ok,
         Timeout,
+        CrcError,
         Error,
     };
 
@@ -41,6 +51,15 @@ class Communicator : public QObject
         InProgress,
     };
 
+    enum class PipelineState
+    {
+        None,
+        Running,
+        Draining,
+        Finished,
+        Failed,
+    };
+
     struct BinHeader
     {
         uint32_t magic;
@@ -50,43 +69,161 @@ class Communicator : public QObject
 
     Q_OBJECT
 public:
+    // Highest baud rate tried by link setup
+    static constexpr int linkBaudRateMax = 921600;
+
+    /**
+     * @brief Acknowledged command types, round trip time is measured for each of them
+     */
+    enum class Command
+    {
+        DownloadRecent,
+        DownloadHistoric,
+        DownloadType,
+        DownloadId,
+        DownloadSize,
+        DownloadData,
+        LogLevel,
+        BaudRate,
+        LinkTest,
+
+        Count
+    };
+
+    /**
+     * @brief Line counters of the download session
+     */
+    struct SessionCounters
+    {
+        qint64 rxBytes = 0;
+        qint64 txBytes = 0;
+        qint64 keepAlives = 0;
+        // Keep alives not sent because a command or pipelined download was in progress
+        qint64 keepAlivesSuppressed = 0;
+        // Keep alives postponed because of other traffic on the line
+        qint64 keepAlivesDeferred = 0;
+    };
+
+    /**
+     * @brief Handler of the data packet downloaded in pipelined mode
+     * Called in packet id order with the received frame buffer, return false to stop downloading
+     * Packets from start id up to end id (not included) are requested
+     */
+    using PacketHandler = std::function<bool(int packetId, QByteArray data)>;
+
     explicit Communicator(SerialPort *serialPort, QObject *parent = nullptr);
     ~Communicator();
 
+    double lineRate();
+    CommandStats commandStats(Command command) const;
+    static QString commandName(Command command);
+    SessionCounters sessionCounters() const;
+    SerialPort::TxStats txStats() const;
+    QString txStatsText() const;
+    QString statsText() const;
+    void resetSessionCounters();
+    qint64 corruptedFrames() const;
+    qint64 discardedBytes() const;
+    qint64 readAllocations() const;
+    BufferPool &framePool();
+
+    bool setupLink(int maxBaudRate);
+    void closeLink();
     bool setDownloadRecent(int startId, int endId);
     bool setDownloadHistoric(time_t startTime, int startId, int endId);
     bool setDownloadType(int sensorType, int dataType);
     bool setDownloadId(int id);
     bool getDownloadSize(int &size);
     bool getDownloadData(int &packetId, QByteArray &data);
+    bool getDownloadDataPipelined(int startId, int endId, int window, const PacketHandler &handler);
 
 signals:
     void textDataReceived(const QString &string);
     void binDataReceived(const QByteArray &data);
     void ackReceived();
+    void linkReady(bool result, int baudRate);
 
 private slots:
     void onPortOpened();
     void onPortClosed();
-    void onPortRead(QByteArray data);
+    void onPortRead(const QByteArray &data);
     void onKeepAliveTimeout();
+    void onPipelineTimeout();
 
 private:
     void resetRxState(bool waitBinData = false);
     void sendKeepAlive();
-    bool sendCommand(const QByteArray &data, std::chrono::milliseconds timeout, bool waitBinData = false);
+    void onWritten(qint64 bytes);
+    bool sendCommand(Command command, const QByteArray &data, bool waitBinData = false);
     AckResult waitForAck(std::chrono::milliseconds timeout);
+    bool switchBaudRate(int baudRate, int fallbackBaudRate);
+    bool sendBaudRate(int baudRate);
+    bool restoreBaudRate();
+    bool findBaudRate();
+    bool testLink();
+    void delay(std::chrono::milliseconds time);
+    bool requestPipelinePacket(int id);
+    bool retryPipelinePacket(int id);
+    void onPipelinePacket(int packetId, bool isValid);
+    void onPipelineCorruptedFrame();
+    void onSkippedText(const char *data, qsizetype size);
+    void onPipelineError();
+    void onCorruptedFrame();
+    void finishPipeline(PipelineState state);
+    std::chrono::milliseconds pipelineTimeout();
+    std::chrono::microseconds wireTime(qint64 bytes);
 
     SerialPort *serialPort = nullptr;
+    // Rate the port is opened with, device is switched back to it before the port is closed
+    int defaultBaudRate = 0;
+    // Keep alive is sent only after the period without other traffic
     QTimer keepAliveTimer;
+    qint64 lastActivityNs = 0;
     QEventLoop ackEventLoop;
+    QTimer ackTimer;
+    std::chrono::milliseconds ackTimeout = std::chrono::milliseconds::zero();
+
+    // Round trip time statistics and last response size per command
+    QElapsedTimer clock;
+    std::array<CommandStats, static_cast<int>(Command::Count)> stats;
+    std::array<qint64, static_cast<int>(Command::Count)> responseBytes = {};
+    qint64 rxByteCount = 0;
+
+    // Damaged data and line counters of the download session
+    SessionCounters session;
+    qint64 rxCorruptedFrames = 0;
+    qint64 rxDiscardedBytes = 0;
 
     RxState rxState = RxState::WaitEndLine;
     AckState ackState = AckState::None;
     SendState sendState = SendState::None;
     QString rxTextData;
+    // Text line skipped while waiting for the binary frame
+    QByteArray skippedLine;
+    // Keep alives sent but not answered yet
+    int keepAliveAcksPending = 0;
     BinHeader rxBinHeader;
+    // Frame buffers are taken from the pool and given back by the last consumer
+    BufferPool rxFramePool;
     QByteArray rxBinData;
+    uint16_t rxBinCrc = 0;
+    qsizetype rxMagicMatched = 0;
+
+    QTimer pipelineTimer;
+    QEventLoop pipelineEventLoop;
+    PipelineState pipelineState = PipelineState::None;
+    int pipelineWindow = 1;
+    int pipelineNextId = 0;
+    int pipelineEndId = 0;
+    int pipelineDeliverId = 0;
+    QList<int> pipelineRequested;
+    // Hash entries are reused, so steady state download doesn't allocate per packet
+    QHash<int, QByteArray> pipelineReceived;
+    QHash<int, int> pipelineRetries;
+    QHash<int, qint64> pipelineSentNs;
+    qint64 pipelineProgressNs = 0;
+    // Packet already requested again because of its corrupted frame, its id line is skipped
+    int pipelineCorruptedId = -1;
 };
 
 #endif // COMMUNICATOR_H
@@ -11,10 +11,11 @@ const char *deviceOnlineString = "Device ONLINE";
 const char *deviceOfflineString = "Device OFFLINE";
 }
 
-Connector::Connector(Ui::MainWindow *ui, SerialPort *serialPort, QObject *parent)
+Connector::Connector(Ui::MainWindow *ui, SerialPort *serialPort, Communicator *communicator, QObject *parent)
     : QObject{parent}
     , ui(ui)
     , serialPort(serialPort)
+    , communicator(communicator)
 {
     connect(ui->comboBoxPortName, &QComboBox::currentTextChanged, this, [=](const QString &text) {
         if (text != portName && text.isEmpty() == false &&
@@ -28,9 +29,12 @@ Connector::Connector(Ui::MainWindow *ui, SerialPort *serialPort, QObject *parent
 
     connect(ui->pushButtonPortConnect, &QPushButton::clicked, this, &Connector::onPortConnect);
 
+    // Serial port lives in the I/O thread, so its signals are queued to the GUI thread
     connect(serialPort, &SerialPort::opened, this, &Connector::onPortOpened);
+    connect(serialPort, &SerialPort::openFailed, this, &Connector::onPortClosed);
     connect(serialPort, &SerialPort::closed, this, &Connector::onPortClosed);
-    connect(serialPort, &SerialPort::read, this, &Connector::onPortRead);
+    connect(serialPort, &SerialPort::activity, this, &Connector::onPortActivity);
+    connect(communicator, &Communicator::linkReady, this, &Connector::onLinkReady);
 
     deviceOnlineTimer.setSingleShot(true);
     connect(&deviceOnlineTimer, &QTimer::timeout, this, &Connector::onDeviceOnlineTimeout);
@@ -39,7 +43,8 @@ Connector::Connector(Ui::MainWindow *ui, SerialPort *serialPort, QObject *parent
 
     updatePortList();
 
-    ui->tabWidget->setEnabled(false);
+    // Capture tab is available without connected device
+    ui->tabConfig->setEnabled(false);
     ui->tabDownload->setEnabled(false);
 }
 
@@ -56,6 +61,9 @@ void Connector::updatePortList()
     {
         ui->comboBoxPortName->addItem(info.portName());
     }
+
+    // Simulated device is always available for testing without hardware
+    ui->comboBoxPortName->addItem(DeviceSimulator::portName);
     portListIsUpdating = false;
 
     if (ui->comboBoxPortName->currentIndex() < 0)
@@ -80,38 +88,62 @@ void Connector::updatePortList()
 
 void Connector::onPortConnect()
 {
-    bool isPortOpened = serialPort->isOpened();
+    SerialPort *port = serialPort;
     if (isPortOpened == false)
     {
         int baudRate = ui->comboBoxBaudRate->currentText().toInt();
         qDebug() << "Open" << portName << "baudrate" << baudRate;
 
-        bool result = serialPort->open(portName, baudRate);
-        if (result == false)
-        {
-            onPortClosed();
-        }
+        // Result is reported back with opened or openFailed signal
+        QString name = portName;
+        QMetaObject::invokeMethod(port, [port, name, baudRate](){
+            port->open(name, baudRate);
+        });
     }
     else
     {
         qDebug() << "Close" << portName;
 
-        serialPort->close();
+        // Device is switched back to the opening rate before the port is closed
+        Communicator *linkCommunicator = communicator;
+        QMetaObject::invokeMethod(linkCommunicator, [linkCommunicator](){
+            linkCommunicator->closeLink();
+        });
     }
 }
 
 void Connector::onPortOpened()
 {
+    isPortOpened = true;
+
     ui->pushButtonPortConnect->setCheckable(true);
     ui->pushButtonPortConnect->setChecked(true);
     ui->pushButtonPortConnect->setText("Close");
 
     ui->comboBoxPortName->setEnabled(false);
     ui->comboBoxBaudRate->setEnabled(false);
+    ui->checkBoxLinkSetup->setEnabled(false);
+
+    if (ui->checkBoxLinkSetup->isChecked() == true)
+    {
+        // Link setup runs in the I/O thread, downloads are enabled when it reports the result
+        isLinkReady = false;
+        Communicator *linkCommunicator = communicator;
+        QMetaObject::invokeMethod(linkCommunicator, [linkCommunicator](){
+            linkCommunicator->setupLink(Communicator::linkBaudRateMax);
+        });
+    }
+    else
+    {
+        isLinkReady = true;
+    }
+    updateTabs();
 }
 
 void Connector::onPortClosed()
 {
+    isPortOpened = false;
+
     deviceOnlineTimer.stop();
     setDeviceOnline(false);
 
@@ -121,21 +153,19 @@ void Connector::onPortClosed()
 
     ui->comboBoxPortName->setEnabled(true);
     ui->comboBoxBaudRate->setEnabled(true);
+    ui->checkBoxLinkSetup->setEnabled(true);
     updatePortList();
 }
 
-void Connector::onPortRead(QByteArray data)
+void Connector::onPortActivity()
 {
-    if (data.size() > 0)
+    if (isDeviceOnline == false)
     {
-        if (isDeviceOnline == false)
-        {
-            qInfo() << deviceOnlineString;
-            setDeviceOnline(true);
-        }
-
-        deviceOnlineTimer.start(deviceOnlineTimeout);
+        qInfo() << deviceOnlineString;
+        setDeviceOnline(true);
     }
+
+    deviceOnlineTimer.start(deviceOnlineTimeout);
 }
 
 void Connector::onDeviceOnlineTimeout()
@@ -144,6 +174,24 @@ void Connector::onDeviceOnlineTimeout()
     setDeviceOnline(false);
 }
 
+void Connector::onLinkReady(bool result, int baudRate)
+{
+    if (result == false)
+    {
+        qWarning() << "Link setup failed, device stays at" << baudRate << "baud";
+    }
+
+    isLinkReady = true;
+    updateTabs();
+}
+
+void Connector::updateTabs()
+{
+    const bool isEnabled = (isDeviceOnline == true && isLinkReady == true);
+    ui->tabConfig->setEnabled(isEnabled);
+    ui->tabDownload->setEnabled(isEnabled);
+}
+
 void Connector::setDeviceOnline(bool isOnline)
 {
     if (isDeviceOnline != isOnline)
@@ -152,18 +200,14 @@ void Connector::setDeviceOnline(bool isOnline)
         if (isDeviceOnline == true)
         {
             ui->labelDeviceState->setText(deviceOnlineString);
-
-            ui->tabWidget->setEnabled(true);
-            ui->tabDownload->setEnabled(true);
+            updateTabs();
 
             emit deviceOnline();
         }
         else
         {
             ui->labelDeviceState->setText(deviceOfflineString);
-
-            ui->tabWidget->setEnabled(false);
-            ui->tabDownload->setEnabled(false);
+            updateTabs();
 
             emit deviceOffline();
         }
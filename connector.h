@@ -6,6 +6,7 @@
 #include <QString>
 #include <QTimer>
 
+#include "communicator.h"
 #include "serialport.h"
 #include "ui_MainWindow.h"
 
@@ -13,7 +14,7 @@ class Connector : public QObject
 {
     Q_OBJECT
 public:
-    explicit Connector(Ui::MainWindow *ui, SerialPort *serialPort, QObject *parent = nullptr);
+    explicit Connector(Ui::MainWindow *ui, SerialPort *serialPort, Communicator *communicator, QObject *parent = nullptr);
     ~Connector();
 
     void updatePortList();
@@ -26,18 +27,24 @@ private slots:
     void onPortConnect();
     void onPortOpened();
     void onPortClosed();
-    void onPortRead(QByteArray data);
+    void onPortActivity();
     void onDeviceOnlineTimeout();
+    void onLinkReady(bool result, int baudRate);
 
 private:
     void setDeviceOnline(bool isOnline);
+    void updateTabs();
 
     QString portName;
     bool portListIsUpdating = false;
+    bool isPortOpened = false;
     bool isDeviceOnline = false;
+    // Commands can't be sent while link setup is in progress
+    bool isLinkReady = false;
 
     Ui::MainWindow *ui = nullptr;
     SerialPort *serialPort = nullptr;
+    Communicator *communicator = nullptr;
     QTimer deviceOnlineTimer;
 };
 
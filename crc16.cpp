@@ -0,0 +1,80 @@
+#include "crc16.h"
+
+#include <array>
+
+namespace
+{
+constexpr uint16_t polynomial = 0xA001;
+constexpr int tablesCount = 4;
+
+using CrcTables = std::array<std::array<uint16_t, 256>, tablesCount>;
+
+/**
+ * @brief Generate lookup tables for slice-by-4 calculation
+ * Table 0 is CRC of every single byte value, table N is table 0 value followed by N zero bytes
+ */
+constexpr CrcTables makeTables()
+{
+    CrcTables tables{};
+
+    for (int value = 0; value < 256; value++)
+    {
+        uint16_t crc = static_cast<uint16_t>(value);
+        for (int i = 0; i < 8; ++i)
+        {
+            if (crc & 0x0001)
+                crc = (crc >> 1) ^ polynomial;
+            else
+                crc >>= 1;
+        }
+        tables[0][value] = crc;
+    }
+
+    for (int table = 1; table < tablesCount; table++)
+    {
+        for (int value = 0; value < 256; value++)
+        {
+            uint16_t crc = tables[table - 1][value];
+            tables[table][value] = (crc >> 8) ^ tables[0][crc & 0xFF];
+        }
+    }
+
+    return tables;
+}
+
+constexpr CrcTables crcTables = makeTables();
+}
+
+uint16_t Crc16::calculate(const QByteArray &data)
+{
+    return update(initValue, data.constData(), data.size());
+}
+
+uint16_t Crc16::update(uint16_t crc, const char *data, qsizetype size)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data);
+
+    // Process 4 bytes per step, CRC overlaps only the first two of them
+    while (size >= 4)
+    {
+        uint16_t value = crc ^ (bytes[0] | (bytes[1] << 8));
+        crc = crcTables[3][value & 0xFF] ^ crcTables[2][value >> 8] ^
+              crcTables[1][bytes[2]] ^ crcTables[0][bytes[3]];
+        bytes += 4;
+        size -= 4;
+    }
+
+    while (size > 0)
+    {
+        crc = (crc >> 8) ^ crcTables[0][(crc ^ *bytes) & 0xFF];
+        bytes++;
+        size--;
+    }
+
+    return crc;
+}
+
+uint16_t Crc16::update(uint16_t crc, uint8_t byte)
+{
+    return (crc >> 8) ^ crcTables[0][(crc ^ byte) & 0xFF];
+}
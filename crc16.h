@@ -0,0 +1,21 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <cstdint>
+
+#include <QByteArray>
+
+/**
+ * @brief CRC16-MODBUS calculation (polynomial 0xA001 reflected, initial value 0xFFFF)
+ */
+class Crc16
+{
+public:
+    static constexpr uint16_t initValue = 0xFFFF;
+
+    static uint16_t calculate(const QByteArray &data);
+    static uint16_t update(uint16_t crc, const char *data, qsizetype size);
+    static uint16_t update(uint16_t crc, uint8_t byte);
+};
+
+#endif // CRC16_H
@@ -0,0 +1,520 @@
+#include "devicesimulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QMetaObject>
+#include <QStringList>
+
+#include "crc16.h"
+#include "packets.h"
+
+namespace
+{
+// Line is served with the finest timer resolution, bytes due since the last tick are delivered at once
+constexpr std::chrono::milliseconds linePeriod = std::chrono::milliseconds{1};
+constexpr qint64 nsPerMs = 1000000;
+constexpr uint32_t packetDurationMs = 1000;
+constexpr uint16_t packetSampleTimeMs = 1;
+constexpr int maxPsdPoints = 16000;
+constexpr int maxRawSamples = 32000;
+constexpr int minBaudRate = 1200;
+constexpr int maxBaudRate = 921600;
+constexpr qint64 baudConfirmTimeoutNs = 1000 * nsPerMs;
+// Share of damaged bytes above the configured baud rate limit
+constexpr double unreliableCorruptionRate = 0.001;
+
+const char *commandPrefix = "!123:";
+const char *ackResponse = "OK\r";
+const char *errorResponse = "ERR\r";
+const char endOfLine = '\r';
+constexpr uint32_t magicPattern = 0xFEDCBA98;
+}
+
+DeviceSimulator::Config DeviceSimulator::Config::fromString(const QString &text)
+{
+    Config config;
+
+    const QStringList items = text.split(',', Qt::SkipEmptyParts);
+    for (const QString &item : items)
+    {
+        const QString key = item.section('=', 0, 0).trimmed();
+        const QString value = item.section('=', 1).trimmed();
+        if (key == "latency")
+        {
+            config.latencyMs = value.toInt();
+        }
+        else if (key == "jitter")
+        {
+            config.jitterMs = value.toInt();
+        }
+        else if (key == "loss")
+        {
+            config.lossRate = value.toDouble();
+        }
+        else if (key == "corrupt")
+        {
+            config.corruptionRate = value.toDouble();
+        }
+        else if (key == "points")
+        {
+            // Packet has to fit into 16 bit frame length
+            config.psdPoints = std::clamp(value.toInt(), 1, maxPsdPoints);
+        }
+        else if (key == "samples")
+        {
+            config.rawSamples = std::clamp(value.toInt(), 1, maxRawSamples);
+        }
+        else if (key == "maxbaud")
+        {
+            config.maxBaudRate = value.toInt();
+        }
+        else if (key == "seed")
+        {
+            config.seed = value.toUInt();
+        }
+        else
+        {
+            qWarning() << "Unknown simulator option:" << key;
+        }
+    }
+
+    return config;
+}
+
+QString DeviceSimulator::Config::toString() const
+{
+    return QString("latency=%1,jitter=%2,loss=%3,corrupt=%4,points=%5,samples=%6,maxbaud=%7,seed=%8")
+        .arg(latencyMs).arg(jitterMs).arg(lossRate).arg(corruptionRate)
+        .arg(psdPoints).arg(rawSamples).arg(maxBaudRate).arg(seed);
+}
+
+DeviceSimulator::DeviceSimulator(QObject *parent)
+    : QIODevice{parent}
+    , lineTimer(this)
+{
+    lineTimer.setTimerType(Qt::PreciseTimer);
+    connect(&lineTimer, &QTimer::timeout, this, &DeviceSimulator::onLineTimeout);
+}
+
+DeviceSimulator::~DeviceSimulator()
+{
+}
+
+void DeviceSimulator::setConfig(const Config &newConfig)
+{
+    config = newConfig;
+}
+
+void DeviceSimulator::setBaudRate(int baudRate)
+{
+    portBaudRate = std::max(baudRate, 10);
+}
+
+int DeviceSimulator::baudRate() const
+{
+    return portBaudRate;
+}
+
+bool DeviceSimulator::open(OpenMode mode)
+{
+    random.seed(config.seed);
+    if (clock.isValid() == false)
+    {
+        // Device is powered on at the rate the port is first opened with,
+        // later it keeps its rate and pending switch across reopening as the hardware does
+        clock.start();
+        deviceBaudRate = portBaudRate;
+        previousBaudRate = portBaudRate;
+    }
+
+    rxCommand.clear();
+    rxLineFreeNs = 0;
+    txResponses.clear();
+    txLineFreeNs = 0;
+    txReadyNs = 0;
+    readBuffer.clear();
+
+    packetsSent = 0;
+    bytesSent = 0;
+    bytesLost = 0;
+    bytesCorrupted = 0;
+
+    qInfo() << "Simulator started," << portBaudRate << "baud, device at" << deviceBaudRate << "baud," << config.toString();
+
+    return QIODevice::open(mode);
+}
+
+void DeviceSimulator::close()
+{
+    if (isOpen() == false)
+    {
+        return;
+    }
+
+    lineTimer.stop();
+    qInfo() << "Simulator stopped, sent" << packetsSent << "packet(s)," << bytesSent << "bytes, lost"
+            << bytesLost << "bytes, corrupted" << bytesCorrupted << "bytes";
+
+    QIODevice::close();
+}
+
+bool DeviceSimulator::isSequential() const
+{
+    return true;
+}
+
+qint64 DeviceSimulator::bytesAvailable() const
+{
+    return readBuffer.size() + QIODevice::bytesAvailable();
+}
+
+qint64 DeviceSimulator::readData(char *data, qint64 maxSize)
+{
+    const qint64 size = std::min<qint64>(maxSize, readBuffer.size());
+    memcpy(data, readBuffer.constData(), size);
+    readBuffer.remove(0, size);
+    return size;
+}
+
+qint64 DeviceSimulator::writeData(const char *data, qint64 maxSize)
+{
+    // Written bytes reach the device after their time on the line
+    const qint64 nowNs = clock.nsecsElapsed();
+    rxLineFreeNs = std::max(rxLineFreeNs, nowNs) + maxSize * byteNs();
+
+    for (qint64 pos = 0; pos < maxSize; pos++)
+    {
+        if (data[pos] == endOfLine)
+        {
+            processCommand(rxCommand, rxLineFreeNs);
+            rxCommand.clear();
+        }
+        else
+        {
+            rxCommand.append(data[pos]);
+        }
+    }
+
+    // Report written bytes asynchronously as the real port does
+    QMetaObject::invokeMethod(this, [this, maxSize](){
+        emit bytesWritten(maxSize);
+    }, Qt::QueuedConnection);
+
+    return maxSize;
+}
+
+void DeviceSimulator::onLineTimeout()
+{
+    const qint64 nowNs = clock.nsecsElapsed();
+    const qint64 available = readBuffer.size();
+
+    while (txResponses.isEmpty() == false)
+    {
+        Response &response = txResponses.first();
+        if (nowNs < response.startNs)
+        {
+            break;
+        }
+
+        const qsizetype due = std::min<qint64>(response.data.size(), (nowNs - response.startNs) / byteNs());
+        if (due > response.sent)
+        {
+            deliver(response.data.constData() + response.sent, due - response.sent);
+            response.sent = due;
+        }
+
+        if (response.sent < response.data.size())
+        {
+            break;
+        }
+        txResponses.removeFirst();
+    }
+
+    if (txResponses.isEmpty())
+    {
+        lineTimer.stop();
+    }
+
+    if (readBuffer.size() > available)
+    {
+        emit readyRead();
+    }
+}
+
+void DeviceSimulator::processCommand(const QByteArray &command, qint64 receivedNs)
+{
+    if (command.startsWith(commandPrefix) == false)
+    {
+        qWarning() << "Simulator: unexpected data" << command;
+        return;
+    }
+
+    if (baudConfirmNs != 0 && receivedNs > baudConfirmNs)
+    {
+        qInfo() << "Simulator:" << deviceBaudRate << "baud isn't confirmed, back to" << previousBaudRate << "baud";
+        deviceBaudRate = previousBaudRate;
+        baudConfirmNs = 0;
+    }
+
+    if (deviceBaudRate != portBaudRate)
+    {
+        // Command sent at the other rate is garbage for the device
+        qDebug() << "Simulator: command lost, device is at" << deviceBaudRate << "baud";
+        return;
+    }
+
+    const QByteArray body = command.mid(strlen(commandPrefix));
+    const QByteArray name = body.left(4);
+    const QList<QByteArray> args = body.mid(5).split(',');
+
+    if (name == "KPLV")
+    {
+        sendResponse(ackResponse, receivedNs);
+    }
+    else if (name == "DWNR" && args.size() == 2)
+    {
+        isHistoric = false;
+        packetCount = std::max(args[1].toInt() - args[0].toInt() + 1, 0);
+        startTime = static_cast<uint32_t>(QDateTime::currentSecsSinceEpoch()) - packetCount * packetDurationMs / 1000;
+        sendResponse(ackResponse, receivedNs);
+    }
+    else if (name == "DWNH" && args.size() == 3)
+    {
+        isHistoric = true;
+        startTime = args[0].toUInt();
+        packetCount = std::max(args[2].toInt() - args[1].toInt() + 1, 0);
+        sendResponse(ackResponse, receivedNs);
+    }
+    else if (name == "DWNT" && args.size() == 2)
+    {
+        sensorType = args[0].toInt();
+        dataType = args[1].toInt();
+        sendResponse(ackResponse, receivedNs);
+    }
+    else if (name == "DWNI" && args.size() == 1)
+    {
+        downloadId = args[0].toInt();
+        sendResponse(ackResponse, receivedNs);
+    }
+    else if (body == "DWNS?")
+    {
+        sendResponse(QByteArray::number(packetCount * packetSize()) + endOfLine, receivedNs);
+    }
+    else if (body == "DWND?")
+    {
+        if (downloadId < 0 || downloadId >= packetCount)
+        {
+            sendResponse(errorResponse, receivedNs);
+            return;
+        }
+
+        packetsSent++;
+        sendResponse(makeFrame(makePacket(downloadId), downloadId), receivedNs);
+    }
+    else if (name == "BAUD" && args.size() == 1)
+    {
+        const int baudRate = args[0].toInt();
+        if (baudRate < minBaudRate || baudRate > maxBaudRate)
+        {
+            sendResponse(errorResponse, receivedNs);
+            return;
+        }
+
+        // Acknowledge at the current rate, the host switches after that
+        sendResponse(ackResponse, receivedNs);
+        if (baudRate == deviceBaudRate)
+        {
+            // Repeated command at the new rate confirms it
+            baudConfirmNs = 0;
+        }
+        else
+        {
+            qInfo() << "Simulator: switch to" << baudRate << "baud";
+            previousBaudRate = deviceBaudRate;
+            deviceBaudRate = baudRate;
+            baudConfirmNs = receivedNs + baudConfirmTimeoutNs;
+        }
+    }
+    else if (name == "TEST" && args.size() == 1)
+    {
+        const int size = args[0].toInt();
+        if (size <= 0 || size > 0xFFFF)
+        {
+            sendResponse(errorResponse, receivedNs);
+            return;
+        }
+
+        // All byte values in turn
+        QByteArray payload(size, Qt::Uninitialized);
+        for (int idx = 0; idx < size; idx++)
+        {
+            payload[idx] = static_cast<char>(idx);
+        }
+        sendResponse(makeFrame(payload, size), receivedNs);
+    }
+    else
+    {
+        // Other settings, e.g. logging level, are accepted without effect
+        sendResponse(ackResponse, receivedNs);
+    }
+}
+
+void DeviceSimulator::sendResponse(const QByteArray &data, qint64 receivedNs)
+{
+    // Device answers commands in order, so jitter can't reorder responses
+    qint64 readyNs = receivedNs + config.latencyMs * nsPerMs;
+    if (config.jitterMs > 0)
+    {
+        readyNs += random.bounded(config.jitterMs + 1) * nsPerMs;
+    }
+    readyNs = std::max(readyNs, txReadyNs);
+    txReadyNs = readyNs;
+
+    const qint64 startNs = std::max(txLineFreeNs, readyNs);
+    txLineFreeNs = startNs + data.size() * byteNs();
+    txResponses.append({startNs, data, 0});
+
+    if (lineTimer.isActive() == false)
+    {
+        lineTimer.start(linePeriod);
+    }
+}
+
+void DeviceSimulator::deliver(const char *data, qsizetype size)
+{
+    bytesSent += size;
+
+    // Adapter above its limit damages the data
+    const double corruptionRate = (portBaudRate > config.maxBaudRate) ? unreliableCorruptionRate : config.corruptionRate;
+    if (config.lossRate <= 0.0 && corruptionRate <= 0.0)
+    {
+        readBuffer.append(data, size);
+        return;
+    }
+
+    for (qsizetype pos = 0; pos < size; pos++)
+    {
+        if (config.lossRate > 0.0 && random.generateDouble() < config.lossRate)
+        {
+            bytesLost++;
+            continue;
+        }
+
+        char byte = data[pos];
+        if (corruptionRate > 0.0 && random.generateDouble() < corruptionRate)
+        {
+            byte ^= static_cast<char>(1 << random.bounded(8));
+            bytesCorrupted++;
+        }
+        readBuffer.append(byte);
+    }
+}
+
+QByteArray DeviceSimulator::makeFrame(const QByteArray &payload, int id) const
+{
+    const uint16_t crc = Crc16::calculate(payload);
+    const uint16_t length = static_cast<uint16_t>(payload.size());
+
+    // Binary frame is followed by the id text line
+    QByteArray frame;
+    frame.reserve(8 + payload.size() + 8);
+    frame.append(static_cast<char>(magicPattern & 0xFF));
+    frame.append(static_cast<char>((magicPattern >> 8) & 0xFF));
+    frame.append(static_cast<char>((magicPattern >> 16) & 0xFF));
+    frame.append(static_cast<char>((magicPattern >> 24) & 0xFF));
+    frame.append(static_cast<char>(crc & 0xFF));
+    frame.append(static_cast<char>(crc >> 8));
+    frame.append(static_cast<char>(length & 0xFF));
+    frame.append(static_cast<char>(length >> 8));
+    frame.append(payload);
+    frame.append(QByteArray::number(id));
+    frame.append(endOfLine);
+
+    return frame;
+}
+
+QByteArray DeviceSimulator::makePacket(int packetId) const
+{
+    PacketHeader header = {};
+    header.startEpochTime = startTime + packetId * packetDurationMs / 1000;
+    header.durationMs = packetDurationMs;
+    header.sampleTimeMs = packetSampleTimeMs;
+    if (dataType == static_cast<int>(DataType::Raw))
+    {
+        // Raw packet duration is defined by its samples
+        header.durationMs = config.rawSamples * packetSampleTimeMs;
+    }
+    header.dataType = static_cast<uint8_t>(dataType);
+    header.sensorType = static_cast<uint8_t>(sensorType);
+
+    QByteArray packet;
+    packet.reserve(packetSize());
+    packet.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Values are synthetic but deterministic, so repeated downloads produce identical files
+    const float phase = static_cast<float>(packetId + sensorType);
+    if (dataType == static_cast<int>(DataType::Psd))
+    {
+        PsdHeader psdHeader = {};
+        psdHeader.deltaFrequency = 0.5f;
+        psdHeader.points = static_cast<uint32_t>(config.psdPoints);
+        const int peak = (packetId * 7 + sensorType * 13) % std::max(config.psdPoints, 1);
+        psdHeader.coreFrequency = peak * psdHeader.deltaFrequency;
+        psdHeader.coreAmplitude = 1.0f;
+        packet.append(reinterpret_cast<const char*>(&psdHeader), sizeof(psdHeader));
+
+        for (int idx = 0; idx < config.psdPoints; idx++)
+        {
+            const PsdPoint amplitude = 1.0f / (1.0f + std::abs(idx - peak));
+            packet.append(reinterpret_cast<const char*>(&amplitude), sizeof(amplitude));
+        }
+    }
+    else if (dataType == static_cast<int>(DataType::Statistic))
+    {
+        StatisticData statistic = {};
+        statistic.mean = std::sin(phase * 0.1f);
+        statistic.deviation = 0.25f;
+        statistic.max = statistic.mean + 1.0f;
+        statistic.min = statistic.mean - 1.0f;
+        packet.append(reinterpret_cast<const char*>(&statistic), sizeof(statistic));
+    }
+    else
+    {
+        for (int idx = 0; idx < config.rawSamples; idx++)
+        {
+            const RawSample sample = static_cast<RawSample>(std::sin(phase + idx * 0.05f) * 16000);
+            packet.append(reinterpret_cast<const char*>(&sample), sizeof(sample));
+        }
+    }
+
+    return packet;
+}
+
+int DeviceSimulator::packetSize() const
+{
+    int size = sizeof(PacketHeader);
+    if (dataType == static_cast<int>(DataType::Psd))
+    {
+        size += sizeof(PsdHeader) + config.psdPoints * sizeof(PsdPoint);
+    }
+    else if (dataType == static_cast<int>(DataType::Statistic))
+    {
+        size += sizeof(StatisticData);
+    }
+    else
+    {
+        size += config.rawSamples * sizeof(RawSample);
+    }
+
+    return size;
+}
+
+qint64 DeviceSimulator::byteNs() const
+{
+    // Every byte takes 10 bits on the line: start bit, 8 data bits and stop bit
+    return 10LL * 1000000000LL / portBaudRate;
+}
@@ -0,0 +1,115 @@
+#ifndef DEVICESIMULATOR_H
+#define DEVICESIMULATOR_H
+
+#include <cstdint>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QList>
+#include <QRandomGenerator>
+#include <QString>
+#include <QTimer>
+
+/**
+ * @brief Simulated device answering !123: commands, used by SerialPort instead of the real port
+ *
+ * Bytes are delivered in both directions at the configured baud rate (10 bits per byte),
+ * responses are delayed by latency and jitter and can be damaged by byte loss and corruption.
+ * Configuration string is a comma separated list of key=value pairs, see Config::fromString().
+ */
+class DeviceSimulator : public QIODevice
+{
+    Q_OBJECT
+public:
+    static constexpr const char *portName = "Simulator";
+
+    struct Config
+    {
+        int latencyMs = 2;
+        int jitterMs = 0;
+        double lossRate = 0.0;
+        double corruptionRate = 0.0;
+        int psdPoints = 512;
+        int rawSamples = 256;
+        // Bytes sent to the host above this rate are damaged as on an unreliable adapter
+        int maxBaudRate = 921600;
+        quint32 seed = 1;
+
+        static Config fromString(const QString &text);
+        QString toString() const;
+    };
+
+    explicit DeviceSimulator(QObject *parent = nullptr);
+    ~DeviceSimulator();
+
+    void setConfig(const Config &newConfig);
+    void setBaudRate(int baudRate);
+    int baudRate() const;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override;
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private slots:
+    void onLineTimeout();
+
+private:
+    /**
+     * @brief Response waiting for transmission on the simulated line
+     */
+    struct Response
+    {
+        qint64 startNs;
+        QByteArray data;
+        qsizetype sent;
+    };
+
+    void processCommand(const QByteArray &command, qint64 receivedNs);
+    void sendResponse(const QByteArray &data, qint64 receivedNs);
+    void deliver(const char *data, qsizetype size);
+    QByteArray makeFrame(const QByteArray &payload, int id) const;
+    QByteArray makePacket(int packetId) const;
+    int packetSize() const;
+    qint64 byteNs() const;
+
+    Config config;
+    int portBaudRate = 115200;
+    QRandomGenerator random;
+    QElapsedTimer clock;
+    QTimer lineTimer;
+
+    QByteArray rxCommand;
+    qint64 rxLineFreeNs = 0;
+    QList<Response> txResponses;
+    qint64 txLineFreeNs = 0;
+    qint64 txReadyNs = 0;
+    QByteArray readBuffer;
+
+    // Device side rate differs from the port one until the host follows the switch, kept across reopening
+    int deviceBaudRate = 115200;
+    int previousBaudRate = 115200;
+    // New rate is reverted after this time unless confirmed, zero if confirmed
+    qint64 baudConfirmNs = 0;
+
+    // Download parameters selected by the host
+    bool isHistoric = false;
+    uint32_t startTime = 0;
+    int packetCount = 0;
+    int sensorType = 0;
+    int dataType = 0;
+    int downloadId = 0;
+
+    // Statistics of the session, logged on close
+    qint64 packetsSent = 0;
+    qint64 bytesSent = 0;
+    qint64 bytesLost = 0;
+    qint64 bytesCorrupted = 0;
+};
+
+#endif // DEVICESIMULATOR_H
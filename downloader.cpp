@@ -1,39 +1,61 @@
 #include "downloader.h"
 
-#include <chrono>
+#include <utility>
+
 #include <QByteArray>
+#include <QCheckBox>
+#include <QDateTime>
 #include <QDebug>
-#include <QDir>
-#include <QFile>
-#include <QProgressDialog>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QGroupBox>
+#include <QHBoxLayout>
+#include <QSerialPortInfo>
+#include <QVBoxLayout>
 
 #include "parser.h"
 
-Downloader::Downloader(Ui::MainWindow *ui, Communicator *communicator, QObject *parent)
+namespace
+{
+// Live view is updated at most 10 times per second
+constexpr std::chrono::milliseconds liveViewPeriod = std::chrono::milliseconds{100};
+// Number of the latest packets kept in live view
+constexpr int liveViewSize = 200;
+// Number of simulated devices offered for multi download
+constexpr int multiSimulatorCount = 4;
+
+bool isPsdBandsValid(const DownloadRequest &request)
+{
+    QList<PsdAnalysis::Band> bands;
+    return request.isPsdAnalysis == false || PsdAnalysis::parseBands(request.psdBands, bands);
+}
+}
+
+Downloader::Downloader(Ui::MainWindow *ui, DownloadSession *downloadSession, QObject *parent)
     : QObject{parent}
-    , communicator(communicator)
+    , downloadSession(downloadSession)
+    , multiSession(new MultiSession(this))
     , ui(ui)
 {
-    connect(ui->pushButtonDownload, &QPushButton::clicked, this, [=](){
-        ui->pushButtonDownload->setEnabled(false);
-        ui->textBrowserDownload->clear();
+    connect(ui->pushButtonDownload, &QPushButton::clicked, this, &Downloader::download);
+    connect(ui->pushButtonResume, &QPushButton::clicked, this, &Downloader::resume);
+    connect(ui->pushButtonBatch, &QPushButton::clicked, this, &Downloader::downloadBatch);
+    connect(ui->pushButtonMulti, &QPushButton::clicked, this, &Downloader::downloadMulti);
+    connect(ui->listWidgetPackets, &QListWidget::currentItemChanged, this, &Downloader::onPacketSelected);
 
-        qInfo() << "Start downloading";
-        auto startTime = std::chrono::high_resolution_clock::now();
-        bool result = download();
-        if (result == true)
-        {
-            auto endTime = std::chrono::high_resolution_clock::now();
-            auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
-            qInfo() << "Downloading finished in" << durationMs;
-        }
-        else
-        {
-            qWarning() << "Downloading failed";
-        }
+    connect(&liveViewTimer, &QTimer::timeout, this, &Downloader::onLiveViewTimeout);
 
-        ui->pushButtonDownload->setEnabled(true);
-    });
+    // Session lives in the I/O thread, so its signals are queued to the GUI thread
+    connect(downloadSession, &DownloadSession::started, this, &Downloader::onStarted);
+    connect(downloadSession, &DownloadSession::sizeReceived, this, &Downloader::onSizeReceived);
+    connect(downloadSession, &DownloadSession::packetReady, this, &Downloader::onPacketReady);
+    connect(downloadSession, &DownloadSession::progressChanged, this, &Downloader::onProgressChanged);
+    connect(downloadSession, &DownloadSession::batchFinished, this, &Downloader::onBatchFinished);
+    connect(downloadSession, &DownloadSession::finished, this, &Downloader::onFinished);
+
+    connect(multiSession, &MultiSession::progressChanged, this, &Downloader::onMultiProgressChanged);
+    connect(multiSession, &MultiSession::finished, this, &Downloader::onMultiFinished);
 
     QDateTime dateTime = QDateTime::currentDateTime();
     ui->dateTimeEditHistoric->setDateTime(dateTime);
@@ -43,191 +65,380 @@ Downloader::~Downloader()
 {
 }
 
-bool Downloader::download()
+void Downloader::download()
 {
-    int packetFromId = ui->spinBoxPacketFrom->value();
-    int packetToId = ui->spinBoxPacketTo->value();
-    if (packetFromId > packetToId)
+    DownloadRequest request = makeRequest();
+    if (isPsdBandsValid(request) == false)
     {
-        qCritical() << "Packet from > packet to";
-        return false;
+        return;
     }
 
-    if (ui->radioButtonHistoric->isChecked())
+    prepareView();
+
+    // Run the download in the I/O thread, results come back with session signals
+    DownloadSession *session = downloadSession;
+    QMetaObject::invokeMethod(session, [session, request](){
+        session->start(request);
+    });
+}
+
+void Downloader::resume()
+{
+    QString fileName = QFileDialog::getOpenFileName(ui->centralwidget, "Resume download", QString(),
+                                                    "Download checkpoint (*.checkpoint)");
+    if (fileName.isEmpty())
     {
-        QDateTime dateTime = ui->dateTimeEditHistoric->dateTime();
-        time_t startTime = dateTime.toSecsSinceEpoch();
+        return;
+    }
 
-        bool result = communicator->setDownloadHistoric(startTime, packetFromId, packetToId);
-        if (result == false)
-        {
-            qCritical() << "Set historic data params failed";
-            return false;
-        }
+    prepareView();
+
+    // Request parameters and output files are restored from the checkpoint by the session
+    DownloadSession *session = downloadSession;
+    QMetaObject::invokeMethod(session, [session, fileName](){
+        session->resume(fileName);
+    });
+}
+
+void Downloader::downloadBatch()
+{
+    // Sensor and data types are offered from the main window type selectors
+    QDialog dialog(ui->centralwidget);
+    dialog.setWindowTitle("Batch download");
+
+    QGroupBox *sensorGroup = new QGroupBox("Sensor types");
+    QVBoxLayout *sensorLayout = new QVBoxLayout(sensorGroup);
+    QList<QCheckBox*> sensorBoxes;
+    for (int i = 0; i < ui->comboBoxTypeSensor->count(); i++)
+    {
+        QCheckBox *box = new QCheckBox(ui->comboBoxTypeSensor->itemText(i));
+        box->setChecked(i == ui->comboBoxTypeSensor->currentIndex());
+        sensorLayout->addWidget(box);
+        sensorBoxes.append(box);
     }
-    else
+
+    QGroupBox *dataGroup = new QGroupBox("Data types");
+    QVBoxLayout *dataLayout = new QVBoxLayout(dataGroup);
+    QList<QCheckBox*> dataBoxes;
+    for (int i = 0; i < ui->comboBoxTypeData->count(); i++)
+    {
+        QCheckBox *box = new QCheckBox(ui->comboBoxTypeData->itemText(i));
+        box->setChecked(i == ui->comboBoxTypeData->currentIndex());
+        dataLayout->addWidget(box);
+        dataBoxes.append(box);
+    }
+    dataLayout->addStretch();
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    QHBoxLayout *groupsLayout = new QHBoxLayout();
+    groupsLayout->addWidget(sensorGroup);
+    groupsLayout->addWidget(dataGroup);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    layout->addLayout(groupsLayout);
+    layout->addWidget(buttons);
+
+    if (dialog.exec() != QDialog::Accepted)
+    {
+        return;
+    }
+
+    // Every selected sensor and data type pair is downloaded with the same packet window
+    const DownloadRequest baseRequest = makeRequest();
+    if (isPsdBandsValid(baseRequest) == false)
+    {
+        return;
+    }
+
+    QList<DownloadRequest> requests;
+    for (int dataType = 0; dataType < dataBoxes.size(); dataType++)
     {
-        bool result = communicator->setDownloadRecent(packetFromId, packetToId);
-        if (result == false)
+        if (dataBoxes[dataType]->isChecked() == false)
+        {
+            continue;
+        }
+
+        for (int sensorType = 0; sensorType < sensorBoxes.size(); sensorType++)
         {
-            qCritical() << "Set recent data params failed";
-            return false;
+            if (sensorBoxes[sensorType]->isChecked() == false)
+            {
+                continue;
+            }
+
+            DownloadRequest request = baseRequest;
+            request.sensorType = sensorType;
+            request.dataType = dataType;
+            request.sensorName = ui->comboBoxTypeSensor->itemText(sensorType);
+            request.dataName = ui->comboBoxTypeData->itemText(dataType);
+            requests.append(request);
         }
     }
 
-    int sensorType = ui->comboBoxTypeSensor->currentIndex();
-    int dataType = ui->comboBoxTypeData->currentIndex();
-    bool result = communicator->setDownloadType(sensorType, dataType);
-    if (result == false)
+    if (requests.isEmpty())
     {
-        qCritical() << "Set sensor and data types failed";
-        return false;
+        qWarning() << "No sensor and data types selected for batch download";
+        return;
     }
 
-    QString headerText = QString("Download ") + ui->comboBoxTypeSensor->currentText() + " " +
-                         ui->comboBoxTypeData->currentText() + ", requested " +
-                         QString::number(packetToId - packetFromId + 1) + " " +
-                         QString(ui->radioButtonHistoric->isChecked() ? "historical" : "recent") + " packet(s)";
-    ui->textBrowserDownload->append(headerText);
+    prepareView();
 
-    int downloadSize = 0;
-    result = communicator->getDownloadSize(downloadSize);
-    if (result == false)
+    DownloadSession *session = downloadSession;
+    QMetaObject::invokeMethod(session, [session, requests](){
+        session->startBatch(requests);
+    });
+}
+
+void Downloader::downloadMulti()
+{
+    // Port of the main connection is busy, opening it again fails and is reported for that device only
+    QDialog dialog(ui->centralwidget);
+    dialog.setWindowTitle("Multi download");
+
+    QGroupBox *portGroup = new QGroupBox("Ports");
+    QVBoxLayout *portLayout = new QVBoxLayout(portGroup);
+    QList<QCheckBox*> portBoxes;
+    const auto ports = QSerialPortInfo::availablePorts();
+    for (const QSerialPortInfo &info : ports)
+    {
+        portBoxes.append(new QCheckBox(info.portName()));
+    }
+    for (int i = 1; i <= multiSimulatorCount; i++)
     {
-        qCritical() << "Request download size failed";
-        return false;
+        portBoxes.append(new QCheckBox(QString(DeviceSimulator::portName) + " " + QString::number(i)));
+    }
+    for (QCheckBox *box : std::as_const(portBoxes))
+    {
+        portLayout->addWidget(box);
     }
 
-    qInfo() << "Download size:" << downloadSize << "bytes";
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
 
-    QDateTime dateTime = QDateTime::currentDateTime();
-    QString dirPath = dateTime.toString("yyyy-MM-dd");
-    QString fileName = dirPath + "/" + ui->comboBoxTypeData->currentText() + " " +
-                       ui->comboBoxTypeSensor->currentText() + " " +
-                       dateTime.toString("yyyyMMdd_hhmmss");
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    layout->addWidget(portGroup);
+    layout->addWidget(buttons);
 
-    QDir dir;
-    result = dir.exists(dirPath);
-    if (result == false)
+    if (dialog.exec() != QDialog::Accepted)
     {
-        qDebug() << "Create directory:" << dirPath;
-        result = dir.mkpath(dirPath);
-        if (result == false)
+        return;
+    }
+
+    QStringList portNames;
+    for (QCheckBox *box : std::as_const(portBoxes))
+    {
+        if (box->isChecked() == true)
         {
-            qCritical() << "Create directory failed";
-            return false;
+            portNames.append(box->text());
         }
     }
 
-#ifdef QT_DEBUG
-    QFile binfile;
-    binfile.setFileName(fileName + ".bin");
-    qDebug() << "Open file:" << binfile.fileName();
-    result = binfile.open(QIODevice::WriteOnly);
-    if (result == false)
+    const DownloadRequest request = makeRequest();
+    if (isPsdBandsValid(request) == false)
     {
-        qCritical() << "File open failed:" << binfile.errorString();
-        return false;
+        return;
     }
-#endif // QT_DEBUG
 
-    QFile jsonfile;
-    jsonfile.setFileName(fileName + ".json");
-    qDebug() << "Open file:" << jsonfile.fileName();
-    result = jsonfile.open(QIODevice::WriteOnly);
+    int baudRate = ui->comboBoxBaudRate->currentText().toInt();
+    bool result = multiSession->start(portNames, baudRate, ui->checkBoxLinkSetup->isChecked(), request);
     if (result == false)
     {
-        qCritical() << "File open failed:" << jsonfile.errorString();
-        return false;
+        return;
     }
 
-    QProgressDialog progress("", "Cancel", 0, downloadSize);
-    progress.setWindowTitle("Downloading");
-    progress.setModal(true);
-    progress.setValue(0);
-    progress.show();
+    prepareView();
 
-    int downloadId = 0;
-    int downloadOffset = 0;
-    while (downloadOffset < downloadSize)
+    // Sizes arrive from the devices one by one, so the dialog must not reset on intermediate maximum
+    progress = new QProgressDialog("", "Cancel", 0, 0);
+    progress->setWindowTitle("Downloading from " + QString::number(portNames.size()) + " device(s)");
+    progress->setModal(true);
+    progress->setAutoReset(false);
+    progress->setAutoClose(false);
+    progress->show();
+
+    MultiSession *session = multiSession;
+    connect(progress, &QProgressDialog::canceled, this, [session](){
+        session->cancel();
+    });
+}
+
+void Downloader::onStarted(const QString &description)
+{
+    ui->labelDownloadDescription->setText(description);
+}
+
+void Downloader::onSizeReceived(int downloadSize)
+{
+    // Batch download reuses the dialog for every type
+    if (progress != nullptr)
     {
-        result = communicator->setDownloadId(downloadId);
-        if (result == false)
-        {
-            qCritical() << "Request packet id failed";
-            break;
-        }
+        // Dialog is hidden by auto reset when previous type completes
+        progress->setMaximum(downloadSize);
+        progress->setValue(0);
+        progress->show();
+        return;
+    }
 
-        int packetId;
-        QByteArray rawData;
-        auto startTime = std::chrono::high_resolution_clock::now();
-        result = communicator->getDownloadData(packetId, rawData);
-        if (result == false)
-        {
-            qCritical() << "Download data packet failed";
-            break;
-        }
-        auto endTime = std::chrono::high_resolution_clock::now();
+    progress = new QProgressDialog("", "Cancel", 0, downloadSize);
+    progress->setWindowTitle("Downloading");
+    progress->setModal(true);
+    progress->setValue(0);
+    progress->show();
 
-        if (packetId == downloadId)
-        {
-            downloadId++;
-        }
-        else
-        {
-            qWarning() << "Packet id" << QString::number(packetId)
-            << "!= download id" << QString::number(downloadId);
-            continue;
-        }
+    DownloadSession *session = downloadSession;
+    connect(progress, &QProgressDialog::canceled, this, [session](){
+        session->cancel();
+    });
+}
 
-#ifdef QT_DEBUG
-        binfile.write(rawData);
-#endif // QT_DEBUG
+void Downloader::onPacketReady(int packetId, const QByteArray &rawData)
+{
+    // Packets are shown by live view timer in batches
+    liveViewPackets.append(qMakePair(packetId, rawData));
+    if (liveViewPackets.size() > liveViewSize)
+    {
+        liveViewPackets.removeFirst();
+    }
+}
 
-        QByteArray jsonData;
-        result = Parser::toJson(rawData, jsonData);
-        if (result == false)
-        {
-            qCritical() << "Parse data packet failed";
-            break;
-        }
+void Downloader::onProgressChanged(int downloadOffset, double downloadRate)
+{
+    if (progress != nullptr)
+    {
+        progress->setLabelText(QString::number(downloadRate, 'g', 2) + " kB/sec");
+        progress->setValue(downloadOffset);
+    }
+}
 
-        ui->textBrowserDownload->append("Packet " + QString::number(packetId) + ":");
+void Downloader::onBatchFinished(const QString &report)
+{
+    ui->textBrowserDownload->setPlainText(report);
+}
 
-        if (jsonData.isEmpty() == false)
-        {
-            jsonfile.write(jsonData);
-            ui->textBrowserDownload->append(jsonData);
-        }
-        else
-        {
-            qWarning() << "Parsed data is empty";
-        }
+void Downloader::onFinished(bool result)
+{
+    (void)result;
 
-        downloadOffset += rawData.size();
-        qInfo() << "Packet" << packetId << "is ready, total" << downloadOffset << "bytes";
+    if (progress != nullptr)
+    {
+        progress->close();
+        progress->deleteLater();
+        progress = nullptr;
+    }
 
-        if (progress.wasCanceled())
-        {
-            qWarning() << "Download was cancelled";
-            break;
-        }
+    liveViewTimer.stop();
+    onLiveViewTimeout();
 
-        // Calculate rate of raw data bytes downloading in kB/sec
-        auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
-        double downloadRate = static_cast<double>(rawData.size()) * 1000 / (durationMs.count() * 1024);
+    ui->pushButtonDownload->setEnabled(true);
+    ui->pushButtonResume->setEnabled(true);
+    ui->pushButtonBatch->setEnabled(true);
+    ui->pushButtonMulti->setEnabled(true);
+}
 
-        progress.setLabelText(QString::number(downloadRate, 'g', 2) + " kB/sec");
-        progress.setValue(downloadOffset);
+void Downloader::onLiveViewTimeout()
+{
+    if (liveViewPackets.isEmpty())
+    {
+        return;
     }
 
-    progress.close();
-#ifdef QT_DEBUG
-    binfile.close();
-    qDebug() << "File closed:" << binfile.fileName();
-#endif // QT_DEBUG
-    jsonfile.close();
-    qDebug() << "File closed:" << jsonfile.fileName();
+    QListWidget *list = ui->listWidgetPackets;
+    list->setUpdatesEnabled(false);
 
-    return result;
+    for (const auto &packet : std::as_const(liveViewPackets))
+    {
+        QString summary = "Packet " + QString::number(packet.first) + ": " + Parser::toSummary(packet.second);
+        QListWidgetItem *item = new QListWidgetItem(summary);
+        // Raw data is kept to show full packet on demand
+        item->setData(Qt::UserRole, packet.second);
+        list->addItem(item);
+    }
+    liveViewPackets.clear();
+
+    while (list->count() > liveViewSize)
+    {
+        delete list->takeItem(0);
+    }
+
+    if (list->currentItem() == nullptr)
+    {
+        list->scrollToBottom();
+    }
+
+    list->setUpdatesEnabled(true);
+}
+
+void Downloader::onMultiProgressChanged(int downloadOffset, int downloadSize, double downloadRate, int activeDevices)
+{
+    if (progress != nullptr)
+    {
+        progress->setLabelText(QString::number(activeDevices) + " device(s) active, " +
+                               QString::number(downloadRate, 'f', 1) + " kB/sec");
+        progress->setMaximum(downloadSize);
+        progress->setValue(downloadOffset);
+    }
+}
+
+void Downloader::onMultiFinished(const QString &report)
+{
+    onFinished(true);
+    ui->textBrowserDownload->setPlainText(report);
+}
+
+void Downloader::onPacketSelected(QListWidgetItem *item)
+{
+    if (item == nullptr)
+    {
+        ui->textBrowserDownload->clear();
+        return;
+    }
+
+    QByteArray jsonData;
+    const QByteArray rawData = item->data(Qt::UserRole).toByteArray();
+    bool result = Parser::toJson(rawData, jsonData);
+    if (result == true)
+    {
+        ui->textBrowserDownload->setPlainText(jsonData);
+    }
+    else
+    {
+        ui->textBrowserDownload->setPlainText("Packet data parse failed");
+    }
+}
+
+DownloadRequest Downloader::makeRequest() const
+{
+    DownloadRequest request;
+    request.isHistoric = ui->radioButtonHistoric->isChecked();
+    request.startTime = ui->dateTimeEditHistoric->dateTime().toSecsSinceEpoch();
+    request.packetFromId = ui->spinBoxPacketFrom->value();
+    request.packetToId = ui->spinBoxPacketTo->value();
+    request.sensorType = ui->comboBoxTypeSensor->currentIndex();
+    request.dataType = ui->comboBoxTypeData->currentIndex();
+    request.sensorName = ui->comboBoxTypeSensor->currentText();
+    request.dataName = ui->comboBoxTypeData->currentText();
+    request.pipelineWindow = ui->spinBoxPipelineWindow->value();
+    request.isJsonCompact = ui->checkBoxJsonCompact->isChecked();
+    request.exportFormat = static_cast<ExportFormat>(ui->comboBoxExportFormat->currentIndex());
+    request.rawDecimation = ui->spinBoxRawDecimation->value();
+    request.isPsdAnalysis = ui->checkBoxPsdAnalysis->isChecked();
+    request.psdBands = ui->lineEditPsdBands->text();
+    request.isPsdDecibels = ui->checkBoxPsdDecibels->isChecked();
+
+    return request;
+}
+
+void Downloader::prepareView()
+{
+    ui->pushButtonDownload->setEnabled(false);
+    ui->pushButtonResume->setEnabled(false);
+    ui->pushButtonBatch->setEnabled(false);
+    ui->pushButtonMulti->setEnabled(false);
+    ui->labelDownloadDescription->clear();
+    ui->listWidgetPackets->clear();
+    ui->textBrowserDownload->clear();
+    liveViewPackets.clear();
+    liveViewTimer.start(liveViewPeriod);
 }
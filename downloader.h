@@ -1,26 +1,53 @@
 #ifndef DOWNLOADER_H
 #define DOWNLOADER_H
 
+#include <QByteArray>
+#include <QList>
+#include <QListWidgetItem>
 #include <QObject>
+#include <QPair>
+#include <QProgressDialog>
+#include <QTimer>
 
-#include "communicator.h"
+#include "downloadsession.h"
+#include "multisession.h"
 #include "ui_MainWindow.h"
 
 class Downloader : public QObject
 {
     Q_OBJECT
 public:
-    explicit Downloader(Ui::MainWindow *ui, Communicator *communicator, QObject *parent = nullptr);
+    explicit Downloader(Ui::MainWindow *ui, DownloadSession *downloadSession, QObject *parent = nullptr);
     ~Downloader();
 
 signals:
 
 private slots:
-    bool download();
+    void download();
+    void resume();
+    void downloadBatch();
+    void downloadMulti();
+    void onStarted(const QString &description);
+    void onSizeReceived(int downloadSize);
+    void onPacketReady(int packetId, const QByteArray &rawData);
+    void onProgressChanged(int downloadOffset, double downloadRate);
+    void onBatchFinished(const QString &report);
+    void onFinished(bool result);
+    void onLiveViewTimeout();
+    void onPacketSelected(QListWidgetItem *item);
+    void onMultiProgressChanged(int downloadOffset, int downloadSize, double downloadRate, int activeDevices);
+    void onMultiFinished(const QString &report);
 
 private:
-    Communicator *communicator = nullptr;
+    DownloadRequest makeRequest() const;
+    void prepareView();
+
+    DownloadSession *downloadSession = nullptr;
+    MultiSession *multiSession = nullptr;
     Ui::MainWindow *ui = nullptr;
+    QProgressDialog *progress = nullptr;
+    QTimer liveViewTimer;
+    QList<QPair<int, QByteArray>> liveViewPackets;
 };
 
 #endif // DOWNLOADER_H
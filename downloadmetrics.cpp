@@ -0,0 +1,100 @@
+#include "downloadmetrics.h"
+
+namespace
+{
+QString formatMs(double ms)
+{
+    return QString::number(ms, 'f', 3);
+}
+
+QString formatPercent(double part, double total)
+{
+    return QString::number(total > 0 ? part * 100 / total : 0, 'f', 1);
+}
+
+QString formatStageAverage(const DownloadMetrics::Stage &stage)
+{
+    return formatMs(stage.packets > 0 ? static_cast<double>(stage.busyNs) / stage.packets / 1e6 : 0);
+}
+}
+
+QList<DownloadMetrics::Row> DownloadMetrics::rows() const
+{
+    const double elapsedSec = static_cast<double>(elapsedMs) / 1000;
+    const double rxRate = elapsedSec > 0 ? line.rxBytes / elapsedSec : 0;
+    const double payloadRate = elapsedSec > 0 ? payloadBytes / elapsedSec : 0;
+    // Wire time of the frame with its header and packet id line
+    const double packetWireMs = (packets > 0 && lineRate > 0) ? line.rxBytes * 1000 / (packets * lineRate) : 0;
+
+    QList<Row> list = {
+        {"Download", description, ""},
+        {"State", isFinished ? "finished" : "in progress", ""},
+        {"Elapsed", QString::number(elapsedSec, 'f', 1), "s"},
+        {"Packets", QString::number(packets), ""},
+        {"Payload", QString::number(payloadBytes), "bytes"},
+        {"Received", QString::number(line.rxBytes), "bytes"},
+        {"Sent", QString::number(line.txBytes), "bytes"},
+        {"Line rate", QString::number(qRound(lineRate)), "bytes/s"},
+        {"Received rate", QString::number(qRound(rxRate)), "bytes/s"},
+        {"Payload rate", QString::number(qRound(payloadRate)), "bytes/s"},
+        {"Line utilisation", formatPercent(rxRate, lineRate), "%"},
+        {"Payload efficiency", formatPercent(payloadRate, lineRate), "%"},
+        {"Wire time per packet", formatMs(packetWireMs), "ms"},
+        {"Parse time per packet", formatStageAverage(parse), "ms"},
+        {"Parse time max", formatMs(parse.maxNs / 1e6), "ms"},
+        {"Write time per packet", formatStageAverage(write), "ms"},
+        {"Write time max", formatMs(write.maxNs / 1e6), "ms"},
+        {"Corrupted frames", QString::number(corruptedFrames), ""},
+        {"Discarded", QString::number(discardedBytes), "bytes"},
+        {"Keep alives", QString::number(line.keepAlives), ""},
+        {"Keep alives suppressed", QString::number(line.keepAlivesSuppressed), ""},
+        {"Keep alives deferred", QString::number(line.keepAlivesDeferred), ""},
+        {"Transmit requests", QString::number(tx.requests), ""},
+        {"Transmit writes", QString::number(tx.writes), ""},
+        {"Transmit queued max", QString::number(tx.queuedBytesMax), "bytes"},
+        {"Write latency avg", formatMs(tx.completed > 0 ? static_cast<double>(tx.latencyTotalUs) / tx.completed / 1000 : 0), "ms"},
+        {"Write latency max", formatMs(tx.latencyMaxUs / 1000.0), "ms"},
+        {"Write timeouts", QString::number(tx.timeouts), ""},
+        {"Frame buffer allocations", QString::number(frameAllocations), ""},
+        {"Output buffer allocations", QString::number(outputAllocations), ""},
+        {"Read buffer allocations", QString::number(readAllocations), ""},
+        {"Live view copies", QString::number(liveViewCopies), ""},
+    };
+
+    for (int command = 0; command < static_cast<int>(Communicator::Command::Count); command++)
+    {
+        const CommandStats &stats = commands[command];
+        if (stats.samples() == 0 && stats.retries() == 0 && stats.timeouts() == 0)
+        {
+            continue;
+        }
+
+        const QString name = Communicator::commandName(static_cast<Communicator::Command>(command));
+        list.append({name + " samples", QString::number(stats.samples()), ""});
+        list.append({name + " latency min", formatMs(stats.minLatency().count() / 1000.0), "ms"});
+        list.append({name + " latency avg", formatMs(stats.smoothedLatency().count() / 1000.0), "ms"});
+        list.append({name + " latency max", formatMs(stats.maxLatency().count() / 1000.0), "ms"});
+        list.append({name + " retries", QString::number(stats.retries()), ""});
+        list.append({name + " timeouts", QString::number(stats.timeouts()), ""});
+        list.append({name + " CRC failures", QString::number(stats.crcFailures()), ""});
+    }
+
+    return list;
+}
+
+QString DownloadMetrics::toCsv() const
+{
+    QString csv = "metric,value,unit\n";
+    for (const Row &row : rows())
+    {
+        // Only description may contain separators
+        QString value = row.value;
+        if (value.contains(",") || value.contains("\""))
+        {
+            value = "\"" + value.replace("\"", "\"\"") + "\"";
+        }
+        csv += row.name + "," + value + "," + row.unit + "\n";
+    }
+
+    return csv;
+}
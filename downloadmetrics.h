@@ -0,0 +1,58 @@
+#ifndef DOWNLOADMETRICS_H
+#define DOWNLOADMETRICS_H
+
+#include <array>
+
+#include <QList>
+#include <QString>
+
+#include "commandstats.h"
+#include "communicator.h"
+
+/**
+ * @brief Snapshot of the download session metrics, taken in the I/O thread and shown by GUI
+ */
+struct DownloadMetrics
+{
+    /**
+     * @brief Processing time of the pipeline stage
+     */
+    struct Stage
+    {
+        qint64 packets = 0;
+        qint64 busyNs = 0;
+        qint64 maxNs = 0;
+    };
+
+    struct Row
+    {
+        QString name;
+        QString value;
+        QString unit;
+    };
+
+    QString description;
+    bool isFinished = false;
+    qint64 elapsedMs = 0;
+    qint64 packets = 0;
+    qint64 payloadBytes = 0;
+    // Theoretical rate of the line in one direction
+    double lineRate = 0;
+    Communicator::SessionCounters line;
+    SerialPort::TxStats tx;
+    qint64 corruptedFrames = 0;
+    qint64 discardedBytes = 0;
+    qint64 frameAllocations = 0;
+    qint64 outputAllocations = 0;
+    qint64 readAllocations = 0;
+    // Packets copied for the live view
+    qint64 liveViewCopies = 0;
+    Stage parse;
+    Stage write;
+    std::array<CommandStats, static_cast<int>(Communicator::Command::Count)> commands;
+
+    QList<Row> rows() const;
+    QString toCsv() const;
+};
+
+#endif // DOWNLOADMETRICS_H
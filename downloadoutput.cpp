@@ -0,0 +1,240 @@
+#include "downloadoutput.h"
+
+#include <algorithm>
+
+#include <QDebug>
+
+bool DownloadOutput::open(const QString &baseName, const DownloadRequest &request)
+{
+    return resume(baseName, request, State());
+}
+
+bool DownloadOutput::resume(const QString &baseName, const DownloadRequest &request, const State &committed)
+{
+    const bool isResume = (committed.packets > 0);
+
+    exportFormat = request.exportFormat;
+    jsonFormat = request.isJsonCompact ? Parser::JsonFormat::Compact : Parser::JsonFormat::Indented;
+    rawDecimation = std::max(request.rawDecimation, 1);
+    current = committed;
+
+    isPsdAnalysis = request.isPsdAnalysis;
+    psdAnalysis.isDecibels = request.isPsdDecibels;
+    if (isPsdAnalysis == true && PsdAnalysis::parseBands(request.psdBands, psdAnalysis.bands) == false)
+    {
+        return false;
+    }
+
+    bool result = false;
+
+    // Raw packets are always stored, so they can be decoded later in any format
+    if (isResume == true)
+    {
+        result = captureWriter.resume(baseName, committed.packets, committed.rawBytes);
+    }
+    else
+    {
+        result = captureWriter.open(baseName);
+    }
+
+    if (result == false || exportFormat == ExportFormat::Raw)
+    {
+        return result;
+    }
+
+    if (exportFormat == ExportFormat::Columnar)
+    {
+        qDebug() << "Open file:" << baseName + ".col";
+        if (isResume == true)
+        {
+            result = columnarWriter.resume(baseName + ".col", committed.packets, committed.outputValues);
+        }
+        else
+        {
+            result = columnarWriter.open(baseName + ".col");
+        }
+    }
+    else if (exportFormat == ExportFormat::Json)
+    {
+        result = openFile(outputFile, baseName + ".json", committed.outputBytes, isResume);
+    }
+    else
+    {
+        // Samples stream starts with its header, it's a part of committed output
+        const bool isCsv = (exportFormat == ExportFormat::RawCsv);
+        const QByteArray header = isCsv ? QByteArray(RawSeries::csvHeader) : RawSeries::fileHeader();
+        result = openFile(outputFile, baseName + (isCsv ? ".csv" : ".samples"), committed.outputBytes, isResume);
+        if (result == true && isResume == false)
+        {
+            result = (outputFile.write(header) == header.size());
+            current.outputBytes = header.size();
+        }
+    }
+
+    return result;
+}
+
+bool DownloadOutput::parse(const QByteArray &rawData, QByteArray &outputData) const
+{
+    if (isStreamFormat() == false)
+    {
+        // Columnar writer takes values directly from the raw packet, raw capture isn't decoded at all
+        return true;
+    }
+
+    bool result = false;
+    if (exportFormat == ExportFormat::Json)
+    {
+        result = Parser::toJson(rawData, outputData, jsonFormat, isPsdAnalysis ? &psdAnalysis : nullptr);
+    }
+    else
+    {
+        // Samples are taken from the received packet in place and encoded straight to the output
+        RawSeries series;
+        result = series.assign(rawData);
+        if (result == false)
+        {
+            return false;
+        }
+
+        if (exportFormat == ExportFormat::RawCsv)
+        {
+            series.appendCsv(outputData, rawDecimation);
+        }
+        else
+        {
+            series.appendBinary(outputData, rawDecimation);
+        }
+    }
+
+    if (result == true && outputData.isEmpty())
+    {
+        qWarning() << "Parsed data is empty";
+    }
+
+    return result;
+}
+
+bool DownloadOutput::write(const QByteArray &rawData, const QByteArray &outputData)
+{
+    bool result = captureWriter.write(rawData);
+    if (result == false)
+    {
+        return false;
+    }
+
+    if (exportFormat == ExportFormat::Columnar)
+    {
+        result = columnarWriter.write(rawData);
+        current.outputValues = columnarWriter.valueCount();
+    }
+    else if (isStreamFormat() == true && outputData.isEmpty() == false)
+    {
+        result = (outputFile.write(outputData) == outputData.size());
+        current.outputBytes += outputData.size();
+    }
+
+    if (result == true)
+    {
+        current.packets++;
+        current.rawBytes += rawData.size();
+    }
+
+    return result;
+}
+
+bool DownloadOutput::flush()
+{
+    bool result = captureWriter.flush();
+
+    if (exportFormat == ExportFormat::Columnar)
+    {
+        result = columnarWriter.flush() && result;
+    }
+    else if (isStreamFormat() == true)
+    {
+        result = outputFile.flush() && result;
+    }
+
+    return result;
+}
+
+bool DownloadOutput::close()
+{
+    bool result = true;
+
+    captureWriter.close();
+
+    if (exportFormat == ExportFormat::Columnar)
+    {
+        result = columnarWriter.close();
+        qDebug() << "File closed:" << columnarWriter.fileName();
+    }
+    else if (isStreamFormat() == true)
+    {
+        outputFile.close();
+        qDebug() << "File closed:" << outputFile.fileName();
+    }
+
+    return result;
+}
+
+void DownloadOutput::suspend()
+{
+    captureWriter.close();
+
+    if (exportFormat == ExportFormat::Columnar)
+    {
+        columnarWriter.suspend();
+    }
+    else if (isStreamFormat() == true)
+    {
+        outputFile.close();
+    }
+
+    qDebug() << "Output files suspended";
+}
+
+DownloadOutput::State DownloadOutput::state() const
+{
+    return current;
+}
+
+bool DownloadOutput::openFile(QFile &file, const QString &fileName, qint64 committedSize, bool isResume)
+{
+    file.setFileName(fileName);
+    qDebug() << "Open file:" << file.fileName();
+
+    bool result = file.open(isResume ? QIODevice::ReadWrite : QIODevice::WriteOnly);
+    if (result == false)
+    {
+        qCritical() << "File open failed:" << file.errorString();
+        return false;
+    }
+
+    if (isResume == true)
+    {
+        // Drop data written after the last committed packet and continue from there
+        if (file.size() < committedSize)
+        {
+            qCritical() << "File" << fileName << "is shorter than committed data";
+            file.close();
+            return false;
+        }
+
+        result = file.resize(committedSize) && file.seek(committedSize);
+        if (result == false)
+        {
+            qCritical() << "File resume failed:" << file.errorString();
+            file.close();
+        }
+    }
+
+    return result;
+}
+
+bool DownloadOutput::isStreamFormat() const
+{
+    return exportFormat == ExportFormat::Json || exportFormat == ExportFormat::RawCsv ||
+           exportFormat == ExportFormat::RawBinary;
+}
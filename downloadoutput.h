@@ -0,0 +1,58 @@
+#ifndef DOWNLOADOUTPUT_H
+#define DOWNLOADOUTPUT_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include "capturewriter.h"
+#include "columnarwriter.h"
+#include "downloadsession.h"
+#include "parser.h"
+#include "rawseries.h"
+
+/**
+ * @brief Output files of the download: raw capture with index and decoded data in the export format
+ * Parse is called from the parse stage, the rest from the write stage only
+ */
+class DownloadOutput
+{
+public:
+    /**
+     * @brief Committed output state, everything written after it is dropped on resume
+     */
+    struct State
+    {
+        qint64 packets = 0;
+        qint64 rawBytes = 0;
+        qint64 outputBytes = 0;
+        qint64 outputValues = 0;
+    };
+
+    bool open(const QString &baseName, const DownloadRequest &request);
+    bool resume(const QString &baseName, const DownloadRequest &request, const State &committed);
+    bool parse(const QByteArray &rawData, QByteArray &outputData) const;
+    bool write(const QByteArray &rawData, const QByteArray &outputData);
+    bool flush();
+    bool close();
+    void suspend();
+
+    State state() const;
+
+private:
+    static bool openFile(QFile &file, const QString &fileName, qint64 committedSize, bool isResume);
+    bool isStreamFormat() const;
+
+    ExportFormat exportFormat = ExportFormat::Json;
+    Parser::JsonFormat jsonFormat = Parser::JsonFormat::Indented;
+    int rawDecimation = 1;
+    bool isPsdAnalysis = false;
+    PsdAnalysis::Settings psdAnalysis;
+    CaptureWriter captureWriter;
+    // JSON or raw samples stream
+    QFile outputFile;
+    ColumnarWriter columnarWriter;
+    State current;
+};
+
+#endif // DOWNLOADOUTPUT_H
@@ -0,0 +1,500 @@
+#include "downloadsession.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <utility>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+
+#include "checkpoint.h"
+#include "downloadoutput.h"
+#include "packetpipeline.h"
+
+namespace
+{
+const auto checkpointPeriod = std::chrono::seconds(1);
+const auto metricsPeriod = std::chrono::milliseconds(500);
+// Live view is updated 10 times per second, it gets at most this number of packets per update
+const auto liveViewPeriod = std::chrono::milliseconds(100);
+constexpr int liveViewPacketsPerPeriod = 20;
+}
+
+DownloadSession::DownloadSession(Communicator *communicator, QObject *parent)
+    : QObject{parent}
+    , communicator(communicator)
+{
+}
+
+DownloadSession::~DownloadSession()
+{
+}
+
+void DownloadSession::start(const DownloadRequest &request)
+{
+    run(request, nullptr);
+}
+
+void DownloadSession::resume(const QString &checkpointFileName)
+{
+    Checkpoint checkpoint;
+    bool result = checkpoint.load(checkpointFileName);
+    if (result == false)
+    {
+        qCritical() << "Load checkpoint failed:" << checkpointFileName;
+        emit finished(false);
+        return;
+    }
+
+    qInfo() << "Resume download" << checkpoint.baseName << "from packet" << checkpoint.committed.packets;
+    run(checkpoint.request, &checkpoint);
+}
+
+void DownloadSession::startBatch(const QList<DownloadRequest> &requests)
+{
+    isCancelled = false;
+
+    qInfo() << "Start batch downloading," << requests.size() << "type(s)";
+    auto batchStartTime = std::chrono::steady_clock::now();
+
+    QString report;
+    bool result = true;
+    bool isWindowSet = false;
+    for (const DownloadRequest &request : requests)
+    {
+        if (isCancelled == true)
+        {
+            result = false;
+            break;
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+        int downloadedBytes = 0;
+        bool isDownloaded = download(request, nullptr, isWindowSet, downloadedBytes);
+        auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+        double downloadRate = static_cast<double>(downloadedBytes) * 1000 / (std::max<qint64>(durationMs.count(), 1) * 1024);
+
+        QString line = request.sensorName + " " + request.dataName + ": " +
+                       (isDownloaded ? QString("done, ") : QString("FAILED, ")) +
+                       QString::number(downloadedBytes) + " bytes in " + QString::number(durationMs.count()) + " ms, " +
+                       QString::number(downloadRate, 'f', 2) + " kB/sec";
+        qInfo() << "Batch:" << line;
+        report += line + "\n";
+
+        if (isDownloaded == false)
+        {
+            result = false;
+        }
+
+        // Packet window is common for all batch types, so next type requests only data type and size,
+        // unless device state is unknown after failure
+        isWindowSet = isDownloaded;
+    }
+
+    auto batchDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - batchStartTime);
+    QString total = "Total: " + QString::number(requests.size()) + " type(s) in " + QString::number(batchDurationMs.count()) + " ms" +
+                    (isCancelled ? QString(", cancelled") : QString());
+    qInfo() << "Batch downloading finished." << total;
+    report += total;
+
+    emit batchFinished(report);
+    emit finished(result);
+}
+
+void DownloadSession::cancel()
+{
+    // Called from any thread, checked by download loop between packets
+    isCancelled = true;
+}
+
+void DownloadSession::run(const DownloadRequest &request, const Checkpoint *checkpoint)
+{
+    isCancelled = false;
+
+    qInfo() << "Start downloading";
+    auto startTime = std::chrono::high_resolution_clock::now();
+    int downloadedBytes = 0;
+    bool result = download(request, checkpoint, false, downloadedBytes);
+    if (result == true)
+    {
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+        qInfo() << "Downloading finished in" << durationMs;
+    }
+    else
+    {
+        qWarning() << "Downloading failed";
+    }
+
+    emit finished(result);
+}
+
+bool DownloadSession::download(const DownloadRequest &request, const Checkpoint *checkpoint, bool isWindowSet, int &downloadedBytes)
+{
+    int packetFromId = request.packetFromId;
+    int packetToId = request.packetToId;
+    if (packetFromId > packetToId)
+    {
+        qCritical() << "Packet from > packet to";
+        return false;
+    }
+
+    communicator->resetSessionCounters();
+
+    if (isWindowSet == false)
+    {
+        if (request.isHistoric)
+        {
+            bool result = communicator->setDownloadHistoric(request.startTime, packetFromId, packetToId);
+            if (result == false)
+            {
+                qCritical() << "Set historic data params failed";
+                return false;
+            }
+        }
+        else
+        {
+            bool result = communicator->setDownloadRecent(packetFromId, packetToId);
+            if (result == false)
+            {
+                qCritical() << "Set recent data params failed";
+                return false;
+            }
+        }
+    }
+
+    bool result = communicator->setDownloadType(request.sensorType, request.dataType);
+    if (result == false)
+    {
+        qCritical() << "Set sensor and data types failed";
+        return false;
+    }
+
+    QString headerText = QString("Download ") + request.sensorName + " " +
+                         request.dataName + ", requested " +
+                         QString::number(packetToId - packetFromId + 1) + " " +
+                         QString(request.isHistoric ? "historical" : "recent") + " packet(s)";
+    emit started(headerText);
+
+    int downloadSize = 0;
+    result = communicator->getDownloadSize(downloadSize);
+    if (result == false)
+    {
+        qCritical() << "Request download size failed";
+        return false;
+    }
+
+    qInfo() << "Download size:" << downloadSize << "bytes";
+
+    QString fileName;
+    if (checkpoint != nullptr)
+    {
+        // Device must report the same data, otherwise the files can't be continued
+        if (downloadSize != checkpoint->downloadSize)
+        {
+            qCritical() << "Download size" << downloadSize << "differs from checkpoint size"
+                        << checkpoint->downloadSize << ", can't resume";
+            return false;
+        }
+
+        if (request.isHistoric == false)
+        {
+            qWarning() << "Resuming recent data download, packets may be shifted if device logged new data";
+        }
+
+        fileName = checkpoint->baseName;
+    }
+    else
+    {
+        QDateTime dateTime = QDateTime::currentDateTime();
+        QString dirPath = dateTime.toString("yyyy-MM-dd");
+        if (request.outputDir.isEmpty() == false)
+        {
+            dirPath = request.outputDir + "/" + dirPath;
+        }
+        fileName = dirPath + "/" + request.dataName + " " +
+                   request.sensorName + " " +
+                   dateTime.toString("yyyyMMdd_hhmmss");
+
+        QDir dir;
+        result = dir.exists(dirPath);
+        if (result == false)
+        {
+            qDebug() << "Create directory:" << dirPath;
+            result = dir.mkpath(dirPath);
+            if (result == false)
+            {
+                qCritical() << "Create directory failed";
+                return false;
+            }
+        }
+    }
+
+    DownloadOutput output;
+    if (checkpoint != nullptr)
+    {
+        result = output.resume(fileName, request, checkpoint->committed);
+    }
+    else
+    {
+        result = output.open(fileName, request);
+    }
+
+    if (result == false)
+    {
+        return false;
+    }
+
+    // Checkpoint is updated by the write stage only after all files are flushed
+    Checkpoint progress;
+    progress.request = request;
+    progress.baseName = fileName;
+    progress.downloadSize = downloadSize;
+    progress.committed = output.state();
+    const QString checkpointFileName = fileName + Checkpoint::fileSuffix;
+    auto checkpointTime = std::chrono::steady_clock::now();
+
+    auto saveCheckpoint = [&]() -> bool {
+        bool isSaved = output.flush();
+        if (isSaved == true)
+        {
+            progress.committed = output.state();
+            isSaved = progress.save(checkpointFileName);
+        }
+        checkpointTime = std::chrono::steady_clock::now();
+        return isSaved;
+    };
+
+    emit sizeReceived(downloadSize);
+
+    // Parse stage, runs in the parse thread
+    auto parsePacket = [&output](const QByteArray &rawData, QByteArray &outputData) -> bool {
+        return output.parse(rawData, outputData);
+    };
+
+    // Live view state is used by the write stage only, copies counter is read by metrics
+    auto liveViewTime = std::chrono::steady_clock::now();
+    int liveViewPackets = 0;
+    std::atomic<qint64> liveViewCopies = 0;
+
+    // Write stage, runs in the write thread, files are accessed only by this thread until pipeline finished
+    auto writePacket = [&](int packetId, const QByteArray &rawData, const QByteArray &outputData) -> bool {
+        bool isWritten = output.write(rawData, outputData);
+        if (isWritten == true && std::chrono::steady_clock::now() - checkpointTime >= checkpointPeriod)
+        {
+            saveCheckpoint();
+        }
+
+        if (std::chrono::steady_clock::now() - liveViewTime >= liveViewPeriod)
+        {
+            liveViewTime = std::chrono::steady_clock::now();
+            liveViewPackets = 0;
+        }
+
+        // Live view keeps packets for a while, it gets a copy so the frame buffer returns to the pool.
+        // Packets above the live view rate are never shown, so they aren't copied.
+        if (liveViewPackets < liveViewPacketsPerPeriod)
+        {
+            liveViewPackets++;
+            liveViewCopies++;
+            emit packetReady(packetId, QByteArray(rawData.constData(), rawData.size()));
+        }
+        return isWritten;
+    };
+
+    PacketPipeline pipeline(parsePacket, writePacket, &communicator->framePool());
+    pipeline.start();
+
+    // Packets are committed in order, so the next one to download is the number of committed ones
+    const int startId = static_cast<int>(progress.committed.packets);
+    int downloadOffset = static_cast<int>(progress.committed.rawBytes);
+    const int resumeOffset = downloadOffset;
+    int downloadedPackets = 0;
+    auto downloadStartTime = std::chrono::high_resolution_clock::now();
+
+    // Metrics are sent to GUI periodically and once more when the download is over
+    auto metricsTime = std::chrono::steady_clock::now();
+    auto makeMetrics = [&](bool isFinished) {
+        DownloadMetrics metrics;
+        metrics.description = headerText;
+        metrics.isFinished = isFinished;
+        metrics.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::high_resolution_clock::now() - downloadStartTime).count();
+        metrics.packets = downloadedPackets;
+        metrics.payloadBytes = downloadOffset - resumeOffset;
+        metrics.lineRate = communicator->lineRate();
+        metrics.line = communicator->sessionCounters();
+        metrics.tx = communicator->txStats();
+        metrics.corruptedFrames = communicator->corruptedFrames();
+        metrics.discardedBytes = communicator->discardedBytes();
+        metrics.frameAllocations = communicator->framePool().allocations();
+        metrics.outputAllocations = pipeline.outputAllocations();
+        metrics.readAllocations = communicator->readAllocations();
+        metrics.liveViewCopies = liveViewCopies;
+        metrics.parse = {pipeline.parseStageStats().packets, pipeline.parseStageStats().busyNs,
+                         pipeline.parseStageStats().maxNs};
+        metrics.write = {pipeline.writeStageStats().packets, pipeline.writeStageStats().busyNs,
+                         pipeline.writeStageStats().maxNs};
+        for (int command = 0; command < static_cast<int>(Communicator::Command::Count); command++)
+        {
+            metrics.commands[command] = communicator->commandStats(static_cast<Communicator::Command>(command));
+        }
+        return metrics;
+    };
+
+    // Receive stage, hands packet over to the pipeline, return false to stop downloading
+    auto processPacket = [&](int packetId, QByteArray rawData) -> bool {
+        const qsizetype rawSize = rawData.size();
+        result = pipeline.push(packetId, std::move(rawData));
+        if (result == false)
+        {
+            qCritical() << "Process data packet failed";
+            return false;
+        }
+
+        downloadOffset += rawSize;
+        downloadedPackets++;
+        qInfo() << "Packet" << packetId << "is received, total" << downloadOffset << "bytes, queued"
+                << pipeline.parseQueueDepth() << "to parse" << pipeline.writeQueueDepth() << "to write";
+
+        if (isCancelled == true)
+        {
+            qWarning() << "Download was cancelled";
+            return false;
+        }
+
+        // Calculate average rate of raw data bytes downloading in kB/sec
+        auto currentTime = std::chrono::high_resolution_clock::now();
+        auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - downloadStartTime);
+        double downloadRate = static_cast<double>(downloadOffset - resumeOffset) * 1000 / (std::max<qint64>(durationMs.count(), 1) * 1024);
+
+        downloadedBytes = downloadOffset - resumeOffset;
+        emit progressChanged(downloadOffset, downloadRate);
+
+        if (std::chrono::steady_clock::now() - metricsTime >= metricsPeriod)
+        {
+            metricsTime = std::chrono::steady_clock::now();
+            emit metricsChanged(makeMetrics(false));
+        }
+
+        return downloadOffset < downloadSize;
+    };
+
+    int pipelineWindow = request.pipelineWindow;
+    if (pipelineWindow > 1 && downloadOffset < downloadSize)
+    {
+        qDebug() << "Download pipelined," << pipelineWindow << "packets in flight";
+        // Packet ids are counted from the first packet of the requested window
+        const int endId = packetToId - packetFromId + 1;
+        bool isDownloaded = communicator->getDownloadDataPipelined(startId, endId, pipelineWindow, processPacket);
+        if (result == true && isDownloaded == false)
+        {
+            qCritical() << "Download data packets failed";
+            result = false;
+        }
+    }
+    else
+    {
+        int downloadId = startId;
+        while (downloadOffset < downloadSize)
+        {
+            result = communicator->setDownloadId(downloadId);
+            if (result == false)
+            {
+                qCritical() << "Request packet id failed";
+                break;
+            }
+
+            int packetId;
+            QByteArray rawData;
+            result = communicator->getDownloadData(packetId, rawData);
+            if (result == false)
+            {
+                qCritical() << "Download data packet failed";
+                break;
+            }
+
+            if (packetId == downloadId)
+            {
+                downloadId++;
+            }
+            else
+            {
+                qWarning() << "Packet id" << QString::number(packetId)
+                << "!= download id" << QString::number(downloadId);
+                continue;
+            }
+
+            bool proceed = processPacket(packetId, std::move(rawData));
+            if (proceed == false)
+            {
+                break;
+            }
+        }
+    }
+
+    if (isCancelled == true && downloadOffset < downloadSize)
+    {
+        // Incomplete download is kept with its checkpoint to be resumed later
+        result = false;
+    }
+    else if (result == true && downloadOffset < downloadSize)
+    {
+        qCritical() << "Device has no more packets, downloaded" << downloadOffset << "of" << downloadSize << "bytes";
+        result = false;
+    }
+
+    // Compare achieved raw data rate with theoretical line rate
+    auto downloadEndTime = std::chrono::high_resolution_clock::now();
+    auto downloadDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(downloadEndTime - downloadStartTime);
+    double bytesPerSec = static_cast<double>(downloadOffset - resumeOffset) * 1000 / std::max<qint64>(downloadDurationMs.count(), 1);
+    double packetsPerSec = static_cast<double>(downloadedPackets) * 1000 / std::max<qint64>(downloadDurationMs.count(), 1);
+    double lineRate = communicator->lineRate();
+    double lineUsage = lineRate > 0 ? bytesPerSec * 100 / lineRate : 0;
+    qInfo() << "Download rate" << qRound(bytesPerSec) << "bytes/sec," << QString::number(packetsPerSec, 'f', 1)
+            << "packets/sec, line rate" << qRound(lineRate) << "bytes/sec, usage" << QString::number(lineUsage, 'f', 1) + "%";
+
+    // Wait for parsing and writing of the received packets
+    bool isProcessed = pipeline.finish();
+    if (isProcessed == false)
+    {
+        qCritical() << "Data packets processing failed";
+        result = false;
+    }
+    qInfo() << "Pipeline stages:" << pipeline.statsText();
+    qInfo() << "Buffers: frame" << communicator->framePool().statsText() + "," << pipeline.bufferStatsText() + ", read"
+            << communicator->readAllocations() << "allocated, live view" << liveViewCopies.load() << "copies";
+    qInfo() << "Link commands:" << communicator->statsText();
+    qInfo() << "Transmit:" << communicator->txStatsText();
+    qInfo() << "Corrupted frames:" << communicator->corruptedFrames() << ", discarded bytes:" << communicator->discardedBytes();
+    emit metricsChanged(makeMetrics(true));
+
+    if (result == true)
+    {
+        bool isClosed = output.close();
+        if (isClosed == false)
+        {
+            result = false;
+        }
+    }
+
+    if (result == true)
+    {
+        QFile::remove(checkpointFileName);
+    }
+    else
+    {
+        // Save everything written so far, columnar file stays incomplete until resumed
+        bool isSaved = saveCheckpoint();
+        output.suspend();
+        if (isSaved == true)
+        {
+            qWarning() << "Download can be resumed from" << checkpointFileName;
+        }
+    }
+
+    return result;
+}
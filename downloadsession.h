@@ -0,0 +1,88 @@
+#ifndef DOWNLOADSESSION_H
+#define DOWNLOADSESSION_H
+
+#include <atomic>
+#include <ctime>
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+#include "communicator.h"
+#include "downloadmetrics.h"
+
+struct Checkpoint;
+
+/**
+ * @brief Downloaded data output file formats, raw capture is written for all of them
+ */
+enum class ExportFormat
+{
+    Json,
+    Columnar,
+    Raw,
+    // Raw time series samples only
+    RawCsv,
+    RawBinary,
+};
+
+/**
+ * @brief Download parameters selected by user
+ */
+struct DownloadRequest
+{
+    bool isHistoric = false;
+    time_t startTime = 0;
+    int packetFromId = 0;
+    int packetToId = 0;
+    int sensorType = 0;
+    int dataType = 0;
+    QString sensorName;
+    QString dataName;
+    int pipelineWindow = 1;
+    bool isJsonCompact = false;
+    ExportFormat exportFormat = ExportFormat::Json;
+    // Raw samples are averaged by this number for samples output
+    int rawDecimation = 1;
+    // PSD analysis is added to JSON output, bands are listed as "from-to" in Hz
+    bool isPsdAnalysis = false;
+    QString psdBands;
+    bool isPsdDecibels = false;
+    // Directory for the dated output directories, current directory if empty
+    QString outputDir;
+};
+
+/**
+ * @brief Download engine, lives in the I/O thread together with communicator
+ */
+class DownloadSession : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DownloadSession(Communicator *communicator, QObject *parent = nullptr);
+    ~DownloadSession();
+
+    void start(const DownloadRequest &request);
+    void resume(const QString &checkpointFileName);
+    void startBatch(const QList<DownloadRequest> &requests);
+    void cancel();
+
+signals:
+    void started(const QString &description);
+    void sizeReceived(int downloadSize);
+    void packetReady(int packetId, const QByteArray &rawData);
+    void progressChanged(int downloadOffset, double downloadRate);
+    void metricsChanged(const DownloadMetrics &metrics);
+    void batchFinished(const QString &report);
+    void finished(bool result);
+
+private:
+    void run(const DownloadRequest &request, const Checkpoint *checkpoint);
+    bool download(const DownloadRequest &request, const Checkpoint *checkpoint, bool isWindowSet, int &downloadedBytes);
+
+    Communicator *communicator = nullptr;
+    std::atomic_bool isCancelled = false;
+};
+
+#endif // DOWNLOADSESSION_H
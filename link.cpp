@@ -0,0 +1,47 @@
+#include "link.h"
+
+#include <QList>
+
+Link::Link(const QString &name, QObject *parent)
+    : QObject{parent}
+{
+    linkSerialPort = new SerialPort();
+    linkCommunicator = new Communicator(linkSerialPort);
+    linkDownloadSession = new DownloadSession(linkCommunicator);
+
+    // Objects are owned by the I/O thread and deleted there when it finishes
+    const QList<QObject*> objects = {linkSerialPort, linkCommunicator, linkDownloadSession};
+    for (QObject *object : objects)
+    {
+        object->moveToThread(&thread);
+        connect(&thread, &QThread::finished, object, &QObject::deleteLater);
+    }
+
+    thread.setObjectName(name);
+    thread.start();
+}
+
+Link::~Link()
+{
+    // Break running download, nested event loops are exited on thread quit
+    linkDownloadSession->cancel();
+
+    thread.requestInterruption();
+    thread.quit();
+    thread.wait();
+}
+
+SerialPort *Link::serialPort()
+{
+    return linkSerialPort;
+}
+
+Communicator *Link::communicator()
+{
+    return linkCommunicator;
+}
+
+DownloadSession *Link::downloadSession()
+{
+    return linkDownloadSession;
+}
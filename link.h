@@ -0,0 +1,33 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+
+#include "communicator.h"
+#include "downloadsession.h"
+#include "serialport.h"
+
+/**
+ * @brief Device link running serial port, communicator and download session in the dedicated I/O thread
+ */
+class Link : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Link(const QString &name, QObject *parent = nullptr);
+    ~Link();
+
+    SerialPort *serialPort();
+    Communicator *communicator();
+    DownloadSession *downloadSession();
+
+private:
+    QThread thread;
+    SerialPort *linkSerialPort = nullptr;
+    Communicator *linkCommunicator = nullptr;
+    DownloadSession *linkDownloadSession = nullptr;
+};
+
+#endif // LINK_H
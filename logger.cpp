@@ -1,11 +1,76 @@
 #include "logger.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+#include <QColor>
 #include <QDateTime>
 #include <QDebug>
+#include <QDir>
+#include <QTextBlockFormat>
+#include <QTextCharFormat>
+#include <QTextCursor>
+
+#include "lockfreequeue.h"
 
 namespace
 {
-QTextBrowser *textBrowser = nullptr;
+/**
+ * @brief Message passed from the message handler to the log view
+ */
+struct LogMessage
+{
+    QtMsgType type = QtMsgType::QtDebugMsg;
+    QString text;
+};
+
+constexpr size_t logQueueCapacity = 4096;
+// Log view is updated at most 10 times per second
+constexpr std::chrono::milliseconds flushPeriod = std::chrono::milliseconds{100};
+// Number of lines kept in log view
+constexpr int logViewLinesMax = 5000;
+
+const char *logFileDir = "logs";
+const char *logFileName = "logs/device_assistant.log";
+constexpr qint64 logFileSizeMax = 10 * 1024 * 1024;
+// Number of rotated log files kept in addition to the current one
+constexpr int logFileBackups = 3;
+
+// Message handler may be called from any thread, so it only pushes into lock free queue
+LockFreeQueue<LogMessage, logQueueCapacity> logQueue;
+std::atomic_int droppedMessages = 0;
+
+QColor messageColor(QtMsgType type)
+{
+    switch (type) {
+    case QtMsgType::QtCriticalMsg:
+    case QtMsgType::QtFatalMsg:
+        return Qt::darkRed;
+    case QtMsgType::QtWarningMsg:
+        return Qt::darkYellow;
+    case QtMsgType::QtInfoMsg:
+        return Qt::darkGreen;
+    default:
+        return Qt::black;
+    }
+}
+
+const char *messageLevel(QtMsgType type)
+{
+    switch (type) {
+    case QtMsgType::QtCriticalMsg:
+        return "CRIT";
+    case QtMsgType::QtFatalMsg:
+        return "FATAL";
+    case QtMsgType::QtWarningMsg:
+        return "WARN";
+    case QtMsgType::QtInfoMsg:
+        return "INFO";
+    default:
+        return "DEBUG";
+    }
+}
 }
 
 Logger::Logger(Ui::MainWindow *ui, QObject *parent)
@@ -13,39 +78,158 @@ Logger::Logger(Ui::MainWindow *ui, QObject *parent)
     , ui(ui)
 {
     // Setup logging to text browser
-    textBrowser = ui->textBrowserLog;
     qInstallMessageHandler([](QtMsgType type, const QMessageLogContext &context, const QString &msg) {
         (void)context;
-        switch (type) {
-        case QtMsgType::QtCriticalMsg:
-        case QtMsgType::QtFatalMsg:
-            textBrowser->setTextColor(Qt::darkRed);
-            break;
-        case QtMsgType::QtWarningMsg:
-            textBrowser->setTextColor(Qt::darkYellow);
-            break;
-        case QtMsgType::QtInfoMsg:
-            textBrowser->setTextColor(Qt::darkGreen);
-            break;
-        default:
-#ifdef QT_DEBUG
-            textBrowser->setTextColor(Qt::black);
-            break;
-#else
+#ifndef QT_DEBUG
+        if (type == QtMsgType::QtDebugMsg)
+        {
             // Ignore debug messages in no Debug build
             return;
+        }
 #endif // QT_DEBUG
+
+        if (type == QtMsgType::QtFatalMsg)
+        {
+            // Application is aborted right after the handler, no chance to show the message
+            fprintf(stderr, "%s\n", qPrintable(msg));
         }
+
         QString timestamp = QDateTime::currentDateTime().toString("HH:mm:ss");
-        QString text = QString("%1: %2").arg(timestamp, msg);
-        textBrowser->append(text);
+        LogMessage message;
+        message.type = type;
+        message.text = QString("%1: %2").arg(timestamp, msg);
+
+        bool result = logQueue.push(std::move(message));
+        if (result == false)
+        {
+            droppedMessages++;
+        }
     });
 
+    ui->textBrowserLog->document()->setMaximumBlockCount(logViewLinesMax);
+
     connect(ui->pushButtonLogClear, &QPushButton::clicked, this, [=](){
         ui->textBrowserLog->clear();
     });
+    connect(ui->checkBoxLogToFile, &QCheckBox::toggled, this, &Logger::onLogToFileToggled);
+
+    connect(&flushTimer, &QTimer::timeout, this, &Logger::onFlushTimeout);
+    flushTimer.start(flushPeriod);
 }
 
 Logger::~Logger()
 {
+    qInstallMessageHandler(nullptr);
+    onFlushTimeout();
+    logFile.close();
+}
+
+void Logger::onFlushTimeout()
+{
+    LogMessage message;
+    if (logQueue.pop(message) == false)
+    {
+        return;
+    }
+
+    // Insert all queued messages in one edit block, so the view layout is updated once
+    QTextCursor cursor(ui->textBrowserLog->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.beginEditBlock();
+
+    bool isFirstBlock = ui->textBrowserLog->document()->isEmpty();
+    QByteArray fileText;
+    do
+    {
+        QTextCharFormat format;
+        format.setForeground(messageColor(message.type));
+        if (isFirstBlock == false)
+        {
+            cursor.insertBlock(QTextBlockFormat(), format);
+        }
+        isFirstBlock = false;
+        cursor.insertText(message.text, format);
+
+        if (logFile.isOpen())
+        {
+            fileText += messageLevel(message.type);
+            fileText += ' ';
+            fileText += message.text.toUtf8();
+            fileText += '\n';
+        }
+    }
+    while (logQueue.pop(message));
+
+    int dropped = droppedMessages.exchange(0);
+    if (dropped > 0)
+    {
+        QTextCharFormat format;
+        format.setForeground(messageColor(QtMsgType::QtWarningMsg));
+        cursor.insertBlock(QTextBlockFormat(), format);
+        cursor.insertText(QString("%1 log message(s) dropped").arg(dropped), format);
+    }
+
+    cursor.endEditBlock();
+    ui->textBrowserLog->ensureCursorVisible();
+
+    if (logFile.isOpen())
+    {
+        logFile.write(fileText);
+        logFile.flush();
+        if (logFile.size() > logFileSizeMax)
+        {
+            rotateLogFile();
+        }
+    }
+}
+
+void Logger::onLogToFileToggled(bool checked)
+{
+    if (checked == true)
+    {
+        bool result = openLogFile();
+        if (result == false)
+        {
+            ui->checkBoxLogToFile->setChecked(false);
+        }
+    }
+    else
+    {
+        logFile.close();
+    }
+}
+
+bool Logger::openLogFile()
+{
+    QDir dir;
+    if (dir.exists(logFileDir) == false && dir.mkpath(logFileDir) == false)
+    {
+        qCritical() << "Create directory failed:" << logFileDir;
+        return false;
+    }
+
+    logFile.setFileName(logFileName);
+    bool result = logFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+    if (result == false)
+    {
+        qCritical() << "Log file open failed:" << logFile.errorString();
+    }
+
+    return result;
+}
+
+void Logger::rotateLogFile()
+{
+    logFile.close();
+
+    // device_assistant.log -> .1 -> .2 ... the oldest one is removed
+    QString oldest = QString("%1.%2").arg(logFileName).arg(logFileBackups);
+    QFile::remove(oldest);
+    for (int idx = logFileBackups - 1; idx >= 1; idx--)
+    {
+        QFile::rename(QString("%1.%2").arg(logFileName).arg(idx), QString("%1.%2").arg(logFileName).arg(idx + 1));
+    }
+    QFile::rename(logFileName, QString("%1.1").arg(logFileName));
+
+    openLogFile();
 }
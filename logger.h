@@ -1,7 +1,9 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <QFile>
 #include <QObject>
+#include <QTimer>
 
 #include "ui_MainWindow.h"
 
@@ -14,8 +16,17 @@ public:
 
 signals:
 
+private slots:
+    void onFlushTimeout();
+    void onLogToFileToggled(bool checked);
+
 private:
+    bool openLogFile();
+    void rotateLogFile();
+
     Ui::MainWindow *ui = nullptr;
+    QTimer flushTimer;
+    QFile logFile;
 };
 
 #endif // LOGGER_H
@@ -1,9 +1,25 @@
 #include "mainwindow.h"
 
 #include <QApplication>
+#include <QCoreApplication>
+
+#include "clidownloader.h"
 
 int main(int argc, char *argv[])
 {
+    // Headless download doesn't create any widgets, so it runs without display
+    if (CliDownloader::isRequested(argc, argv))
+    {
+        QCoreApplication a(argc, argv);
+        CliDownloader cli;
+        bool result = cli.start(a.arguments());
+        if (result == false)
+        {
+            return cli.exitCode();
+        }
+        return a.exec();
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
@@ -1,10 +1,12 @@
 #include "mainwindow.h"
 
+#include "captureviewer.h"
 #include "communicator.h"
 #include "connector.h"
 #include "downloader.h"
+#include "link.h"
 #include "logger.h"
-#include "serialport.h"
+#include "metricsview.h"
 
 #include <QDebug>
 #include <QMessageBox>
@@ -12,11 +14,12 @@
 
 namespace
 {
-Communicator *communicator = nullptr;
+CaptureViewer *captureViewer = nullptr;
 Connector *connector = nullptr;
 Downloader *downloader = nullptr;
+Link *link = nullptr;
 Logger *logger = nullptr;
-SerialPort *serialPort = nullptr;
+MetricsView *metricsView = nullptr;
 
 // Major application version
 constexpr int versionMajor = 0;
@@ -43,14 +46,19 @@ MainWindow::MainWindow(QWidget *parent)
     });
 
     logger = new Logger(ui, this);
-    serialPort = new SerialPort(this);
-    connector = new Connector(ui, serialPort, this);
-    communicator = new Communicator(serialPort, this);
-    downloader = new Downloader(ui, communicator, this);
+    link = new Link("I/O thread", this);
+    connector = new Connector(ui, link->serialPort(), link->communicator(), this);
+    downloader = new Downloader(ui, link->downloadSession(), this);
+    metricsView = new MetricsView(ui, link->downloadSession(), this);
+    captureViewer = new CaptureViewer(ui, this);
 }
 
 MainWindow::~MainWindow()
 {
+    // Stop I/O thread before UI is destroyed
+    delete link;
+    link = nullptr;
+
     delete ui;
 }
 
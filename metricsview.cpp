@@ -0,0 +1,75 @@
+#include "metricsview.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileDialog>
+#include <QTableWidgetItem>
+
+MetricsView::MetricsView(Ui::MainWindow *ui, DownloadSession *downloadSession, QObject *parent)
+    : QObject{parent}
+    , ui(ui)
+{
+    ui->pushButtonExportMetrics->setEnabled(false);
+
+    // Session lives in the I/O thread, so metrics come queued to the GUI thread
+    connect(downloadSession, &DownloadSession::metricsChanged, this, &MetricsView::onMetricsChanged);
+    connect(ui->pushButtonExportMetrics, &QPushButton::clicked, this, &MetricsView::exportCsv);
+}
+
+MetricsView::~MetricsView()
+{
+}
+
+void MetricsView::onMetricsChanged(const DownloadMetrics &metrics)
+{
+    lastMetrics = metrics;
+
+    const QList<DownloadMetrics::Row> rows = metrics.rows();
+    QTableWidget *table = ui->tableWidgetMetrics;
+    table->setRowCount(static_cast<int>(rows.size()));
+    for (int row = 0; row < rows.size(); row++)
+    {
+        const QStringList columns = {rows[row].name, rows[row].value, rows[row].unit};
+        for (int column = 0; column < columns.size(); column++)
+        {
+            QTableWidgetItem *item = table->item(row, column);
+            if (item == nullptr)
+            {
+                item = new QTableWidgetItem();
+                table->setItem(row, column, item);
+            }
+            item->setText(columns[column]);
+        }
+    }
+
+    // Session is exported when it's over
+    ui->pushButtonExportMetrics->setEnabled(metrics.isFinished);
+}
+
+void MetricsView::exportCsv()
+{
+    QString fileName = QFileDialog::getSaveFileName(ui->centralwidget, "Export metrics", "metrics.csv",
+                                                    "CSV (*.csv)");
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    QFile file(fileName);
+    bool result = file.open(QIODevice::WriteOnly | QIODevice::Text);
+    if (result == false)
+    {
+        qCritical() << "File open failed:" << file.errorString();
+        return;
+    }
+
+    const QByteArray csv = lastMetrics.toCsv().toUtf8();
+    result = (file.write(csv) == csv.size());
+    if (result == false)
+    {
+        qCritical() << "File write failed:" << file.errorString();
+        return;
+    }
+
+    qInfo() << "Metrics exported to" << fileName;
+}
@@ -0,0 +1,29 @@
+#ifndef METRICSVIEW_H
+#define METRICSVIEW_H
+
+#include <QObject>
+
+#include "downloadmetrics.h"
+#include "downloadsession.h"
+#include "ui_MainWindow.h"
+
+/**
+ * @brief Live view of the download metrics with export of the last session to CSV
+ */
+class MetricsView : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsView(Ui::MainWindow *ui, DownloadSession *downloadSession, QObject *parent = nullptr);
+    ~MetricsView();
+
+private slots:
+    void onMetricsChanged(const DownloadMetrics &metrics);
+    void exportCsv();
+
+private:
+    Ui::MainWindow *ui = nullptr;
+    DownloadMetrics lastMetrics;
+};
+
+#endif // METRICSVIEW_H
@@ -0,0 +1,215 @@
+#include "multisession.h"
+
+#include <utility>
+
+#include <QDebug>
+
+MultiSession::MultiSession(QObject *parent)
+    : QObject{parent}
+{
+}
+
+MultiSession::~MultiSession()
+{
+    // Links stop their I/O threads on delete
+    for (const Device &device : std::as_const(devices))
+    {
+        delete device.link;
+    }
+}
+
+bool MultiSession::isRunning() const
+{
+    return devices.isEmpty() == false;
+}
+
+bool MultiSession::start(const QStringList &portNames, int baudRate, bool isLinkSetup, const DownloadRequest &request)
+{
+    if (isRunning() == true)
+    {
+        qWarning() << "Multi download is already running";
+        return false;
+    }
+
+    if (portNames.isEmpty())
+    {
+        qWarning() << "No ports selected for multi download";
+        return false;
+    }
+
+    qInfo() << "Start multi download from" << portNames.size() << "device(s)";
+    startTime = std::chrono::steady_clock::now();
+
+    for (int index = 0; index < portNames.size(); index++)
+    {
+        Device device;
+        device.portName = portNames[index];
+        device.link = new Link(device.portName + " I/O thread");
+        devices.append(device);
+    }
+
+    for (int index = 0; index < devices.size(); index++)
+    {
+        const QString portName = devices[index].portName;
+        SerialPort *port = devices[index].link->serialPort();
+        Communicator *communicator = devices[index].link->communicator();
+        DownloadSession *session = devices[index].link->downloadSession();
+
+        DownloadRequest deviceRequest = request;
+        deviceRequest.outputDir = portName;
+
+        // Link objects live in their I/O threads, so signals are queued to the GUI thread
+        connect(port, &SerialPort::opened, this, [communicator, session, isLinkSetup, deviceRequest](){
+            QMetaObject::invokeMethod(session, [communicator, session, isLinkSetup, deviceRequest](){
+                // Failed link setup is reported with link ready signal
+                if (isLinkSetup == false || communicator->setupLink(Communicator::linkBaudRateMax) == true)
+                {
+                    session->start(deviceRequest);
+                }
+            });
+        });
+        connect(port, &SerialPort::openFailed, this, [=](){
+            onDeviceFinished(index, false);
+        });
+        connect(communicator, &Communicator::linkReady, this, [=](bool result){
+            if (result == false)
+            {
+                onDeviceFinished(index, false);
+            }
+        });
+        connect(session, &DownloadSession::sizeReceived, this, [=](int downloadSize){
+            if (index < devices.size())
+            {
+                devices[index].downloadSize = downloadSize;
+                updateProgress();
+            }
+        });
+        connect(session, &DownloadSession::progressChanged, this, [=](int downloadOffset, double downloadRate){
+            if (index < devices.size())
+            {
+                devices[index].downloadOffset = downloadOffset;
+                devices[index].downloadRate = downloadRate;
+                updateProgress();
+            }
+        });
+        connect(session, &DownloadSession::finished, this, [=](bool result){
+            onDeviceFinished(index, result);
+        });
+
+        QMetaObject::invokeMethod(port, [port, portName, baudRate](){
+            port->open(portName, baudRate);
+        });
+    }
+
+    return true;
+}
+
+void MultiSession::cancel()
+{
+    for (const Device &device : std::as_const(devices))
+    {
+        device.link->downloadSession()->cancel();
+    }
+}
+
+void MultiSession::onDeviceFinished(int index, bool result)
+{
+    // Signals queued before the links were deleted may arrive after the end of the download
+    if (index >= devices.size())
+    {
+        return;
+    }
+
+    Device &device = devices[index];
+    if (device.isFinished == true)
+    {
+        return;
+    }
+
+    device.isFinished = true;
+    device.result = result;
+    device.downloadRate = 0;
+    if (result == true)
+    {
+        qInfo() << "Device" << device.portName << "download finished";
+    }
+    else
+    {
+        qWarning() << "Device" << device.portName << "download failed";
+    }
+
+    Communicator *communicator = device.link->communicator();
+    QMetaObject::invokeMethod(communicator, [communicator](){
+        communicator->closeLink();
+    });
+
+    emit deviceFinished(device.portName, result);
+    updateProgress();
+
+    for (const Device &other : std::as_const(devices))
+    {
+        if (other.isFinished == false)
+        {
+            return;
+        }
+    }
+
+    QString report = makeReport();
+    qInfo().noquote() << report;
+
+    // Links are deleted outside of their signal handlers, ports left open are closed on delete
+    for (const Device &other : std::as_const(devices))
+    {
+        other.link->deleteLater();
+    }
+    devices.clear();
+
+    emit finished(report);
+}
+
+void MultiSession::updateProgress()
+{
+    int downloadOffset = 0;
+    int downloadSize = 0;
+    double downloadRate = 0;
+    int activeDevices = 0;
+    for (const Device &device : std::as_const(devices))
+    {
+        downloadOffset += device.downloadOffset;
+        downloadSize += device.downloadSize;
+        downloadRate += device.downloadRate;
+        if (device.isFinished == false)
+        {
+            activeDevices++;
+        }
+    }
+
+    emit progressChanged(downloadOffset, downloadSize, downloadRate, activeDevices);
+}
+
+QString MultiSession::makeReport() const
+{
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+    double elapsedSeconds = std::chrono::duration<double>(elapsed).count();
+
+    QString report;
+    qint64 totalBytes = 0;
+    int failedDevices = 0;
+    for (const Device &device : devices)
+    {
+        report += device.portName + ": " + (device.result ? "OK" : "FAILED") + ", " +
+                  QString::number(device.downloadOffset) + " of " + QString::number(device.downloadSize) + " bytes\n";
+        totalBytes += device.downloadOffset;
+        if (device.result == false)
+        {
+            failedDevices++;
+        }
+    }
+
+    double totalRate = (elapsedSeconds > 0) ? (totalBytes / 1024.0 / elapsedSeconds) : 0;
+    report += "Multi download finished: " + QString::number(devices.size() - failedDevices) + " of " +
+              QString::number(devices.size()) + " device(s), " + QString::number(totalBytes) + " bytes in " +
+              QString::number(elapsedSeconds, 'f', 1) + " sec, " + QString::number(totalRate, 'f', 1) + " kB/sec";
+
+    return report;
+}
@@ -0,0 +1,54 @@
+#ifndef MULTISESSION_H
+#define MULTISESSION_H
+
+#include <chrono>
+
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "downloadsession.h"
+#include "link.h"
+
+/**
+ * @brief Parallel download of the same request from several devices, every port gets its own link and I/O thread
+ * Output of every device is written to the directory named after its port, link setup is run before the download if selected
+ */
+class MultiSession : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MultiSession(QObject *parent = nullptr);
+    ~MultiSession();
+
+    bool isRunning() const;
+    bool start(const QStringList &portNames, int baudRate, bool isLinkSetup, const DownloadRequest &request);
+    void cancel();
+
+signals:
+    void progressChanged(int downloadOffset, int downloadSize, double downloadRate, int activeDevices);
+    void deviceFinished(const QString &portName, bool result);
+    void finished(const QString &report);
+
+private:
+    struct Device
+    {
+        QString portName;
+        Link *link = nullptr;
+        int downloadSize = 0;
+        int downloadOffset = 0;
+        double downloadRate = 0;
+        bool isFinished = false;
+        bool result = false;
+    };
+
+    void onDeviceFinished(int index, bool result);
+    void updateProgress();
+    QString makeReport() const;
+
+    QList<Device> devices;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#endif // MULTISESSION_H
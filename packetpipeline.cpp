@@ -0,0 +1,234 @@
+#include "packetpipeline.h"
+
+#include <algorithm>
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+namespace
+{
+// Packets waiting for every stage, limits memory when a stage is slower than the link
+constexpr qsizetype queueCapacity = 16;
+// Output buffers of the packets in both queues and in both stages
+constexpr qsizetype outputPoolCapacity = 2 * queueCapacity + 2;
+}
+
+PacketPipeline::PacketPipeline(const ParseFunction &parse, const WriteFunction &write, BufferPool *rawDataPool)
+    : parse(parse)
+    , write(write)
+    , rawDataPool(rawDataPool)
+    , outputPool(0, outputPoolCapacity)
+    , parseQueue(queueCapacity)
+    , writeQueue(queueCapacity)
+{
+}
+
+PacketPipeline::~PacketPipeline()
+{
+    finish();
+}
+
+void PacketPipeline::start()
+{
+    parseThread = QThread::create([this](){ parseLoop(); });
+    parseThread->setObjectName("Parse thread");
+    parseThread->start();
+
+    writeThread = QThread::create([this](){ writeLoop(); });
+    writeThread->setObjectName("Write thread");
+    writeThread->start();
+}
+
+bool PacketPipeline::push(int packetId, QByteArray rawData)
+{
+    if (isFailed == true)
+    {
+        if (rawDataPool != nullptr)
+        {
+            rawDataPool->release(rawData);
+        }
+        return false;
+    }
+
+    // Time spent here is the link waiting for slower stages
+    QElapsedTimer timer;
+    timer.start();
+
+    receiveStats.packets++;
+    receiveStats.bytes += rawData.size();
+
+    // Packet owns the only reference to the raw data, so the buffer can return to its pool after writing
+    Packet packet;
+    packet.packetId = packetId;
+    packet.rawData = std::move(rawData);
+    bool result = parseQueue.push(std::move(packet));
+
+    receiveStats.busyNs += timer.nsecsElapsed();
+
+    return result && isFailed == false;
+}
+
+bool PacketPipeline::finish()
+{
+    // Let stages process everything already queued, then stop them
+    parseQueue.close();
+    if (parseThread != nullptr)
+    {
+        parseThread->wait();
+        delete parseThread;
+        parseThread = nullptr;
+    }
+
+    writeQueue.close();
+    if (writeThread != nullptr)
+    {
+        writeThread->wait();
+        delete writeThread;
+        writeThread = nullptr;
+    }
+
+    return isFailed == false;
+}
+
+bool PacketPipeline::hasFailed() const
+{
+    return isFailed;
+}
+
+qsizetype PacketPipeline::parseQueueDepth()
+{
+    return parseQueue.depth();
+}
+
+qsizetype PacketPipeline::writeQueueDepth()
+{
+    return writeQueue.depth();
+}
+
+const PacketPipeline::StageStats &PacketPipeline::parseStageStats() const
+{
+    return parseStats;
+}
+
+const PacketPipeline::StageStats &PacketPipeline::writeStageStats() const
+{
+    return writeStats;
+}
+
+QString PacketPipeline::statsText()
+{
+    return stageText("receive", receiveStats, 0) + ", " +
+           stageText("parse", parseStats, parseQueue.maxDepth()) + ", " +
+           stageText("write", writeStats, writeQueue.maxDepth());
+}
+
+QString PacketPipeline::bufferStatsText() const
+{
+    return "output buffers " + outputPool.statsText();
+}
+
+qint64 PacketPipeline::outputAllocations() const
+{
+    return outputPool.allocations();
+}
+
+void PacketPipeline::parseLoop()
+{
+    Packet packet;
+    while (parseQueue.pop(packet))
+    {
+        if (isFailed == true)
+        {
+            // Drain the queue to release the receive stage
+            release(packet);
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        packet.outputData = outputPool.acquire();
+        bool result = parse(packet.rawData, packet.outputData);
+
+        parseStats.packets++;
+        parseStats.bytes += packet.rawData.size();
+        const qint64 parseNs = timer.nsecsElapsed();
+        parseStats.busyNs += parseNs;
+        parseStats.maxNs = std::max(parseStats.maxNs.load(), parseNs);
+
+        if (result == false)
+        {
+            qCritical() << "Parse data packet" << packet.packetId << "failed";
+            fail();
+            release(packet);
+            continue;
+        }
+
+        writeQueue.push(std::move(packet));
+        packet = Packet();
+    }
+}
+
+void PacketPipeline::writeLoop()
+{
+    Packet packet;
+    while (writeQueue.pop(packet))
+    {
+        if (isFailed == true)
+        {
+            release(packet);
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        bool result = write(packet.packetId, packet.rawData, packet.outputData);
+
+        writeStats.packets++;
+        writeStats.bytes += packet.outputData.size();
+        const qint64 writeNs = timer.nsecsElapsed();
+        writeStats.busyNs += writeNs;
+        writeStats.maxNs = std::max(writeStats.maxNs.load(), writeNs);
+
+        if (result == false)
+        {
+            qCritical() << "Write data packet" << packet.packetId << "failed";
+            fail();
+        }
+
+        release(packet);
+    }
+}
+
+void PacketPipeline::fail()
+{
+    isFailed = true;
+}
+
+void PacketPipeline::release(Packet &packet)
+{
+    // Buffers of dropped packets come back as well, so pool counters show only real allocations
+    if (rawDataPool != nullptr)
+    {
+        rawDataPool->release(packet.rawData);
+    }
+    outputPool.release(packet.outputData);
+}
+
+QString PacketPipeline::stageText(const char *name, const StageStats &stats, qsizetype maxDepth)
+{
+    // Throughput of the stage itself (bytes per busy second), not limited by other stages
+    double busySec = static_cast<double>(stats.busyNs) / 1e9;
+    double rate = busySec > 0 ? static_cast<double>(stats.bytes) / (busySec * 1024) : 0;
+
+    QString text = QString(name) + " " + QString::number(stats.packets.load()) + " packets " +
+                   QString::number(rate, 'f', 1) + " kB/sec busy " +
+                   QString::number(busySec, 'f', 3) + " sec";
+    if (maxDepth > 0)
+    {
+        text += " max queue " + QString::number(maxDepth);
+    }
+
+    return text;
+}
@@ -0,0 +1,89 @@
+#ifndef PACKETPIPELINE_H
+#define PACKETPIPELINE_H
+
+#include <atomic>
+#include <functional>
+
+#include <QByteArray>
+#include <QString>
+#include <QThread>
+
+#include "boundedqueue.h"
+#include "bufferpool.h"
+
+/**
+ * @brief Downloaded packets processing pipeline: receive -> parse -> write
+ * Parse and write stages run in their own threads connected with bounded queues,
+ * so the serial link doesn't wait for formatting and disk I/O
+ */
+class PacketPipeline
+{
+public:
+    /**
+     * @brief Parse stage function, converts raw packet to output data
+     */
+    using ParseFunction = std::function<bool(const QByteArray &rawData, QByteArray &outputData)>;
+    /**
+     * @brief Write stage function, stores converted packet
+     */
+    using WriteFunction = std::function<bool(int packetId, const QByteArray &rawData, const QByteArray &outputData)>;
+
+    /**
+     * @brief Stage counters, updated by the stage thread and read from any thread
+     */
+    struct StageStats
+    {
+        std::atomic<qint64> packets = 0;
+        std::atomic<qint64> bytes = 0;
+        std::atomic<qint64> busyNs = 0;
+        // Longest processing of a single packet
+        std::atomic<qint64> maxNs = 0;
+    };
+
+    PacketPipeline(const ParseFunction &parse, const WriteFunction &write, BufferPool *rawDataPool = nullptr);
+    ~PacketPipeline();
+
+    void start();
+    bool push(int packetId, QByteArray rawData);
+    bool finish();
+    bool hasFailed() const;
+
+    qsizetype parseQueueDepth();
+    qsizetype writeQueueDepth();
+    const StageStats &parseStageStats() const;
+    const StageStats &writeStageStats() const;
+    QString statsText();
+    QString bufferStatsText() const;
+    qint64 outputAllocations() const;
+
+private:
+    struct Packet
+    {
+        int packetId = 0;
+        QByteArray rawData;
+        QByteArray outputData;
+    };
+
+    void parseLoop();
+    void writeLoop();
+    void fail();
+    void release(Packet &packet);
+    static QString stageText(const char *name, const StageStats &stats, qsizetype maxDepth);
+
+    ParseFunction parse;
+    WriteFunction write;
+    // Raw packets are given back to their pool after writing, output buffers are reused by the pipeline
+    BufferPool *rawDataPool = nullptr;
+    BufferPool outputPool;
+    BoundedQueue<Packet> parseQueue;
+    BoundedQueue<Packet> writeQueue;
+    QThread *parseThread = nullptr;
+    QThread *writeThread = nullptr;
+    std::atomic_bool isFailed = false;
+
+    StageStats receiveStats;
+    StageStats parseStats;
+    StageStats writeStats;
+};
+
+#endif // PACKETPIPELINE_H
@@ -0,0 +1,61 @@
+#ifndef PACKETS_H
+#define PACKETS_H
+
+#include <cstdint>
+
+/**
+ * @brief Data type identifiers
+ */
+enum class DataType
+{
+    Psd,
+    Statistic,
+    Raw,
+
+    Count
+};
+
+using PsdPoint = float;
+
+/**
+ * @brief Raw time series sample, Raw packet payload holds durationMs / sampleTimeMs of them
+ */
+using RawSample = int16_t;
+
+#pragma pack(push, 1)
+/**
+ * @brief Single measurements packet header structure
+ */
+struct PacketHeader
+{
+    uint32_t startEpochTime;
+    uint32_t durationMs;
+    uint16_t sampleTimeMs;
+    uint8_t dataType;
+    uint8_t sensorType;
+};
+
+/**
+ * @brief PSD measurements header structure
+ */
+struct PsdHeader
+{
+    float coreFrequency;
+    float coreAmplitude;
+    float deltaFrequency;
+    uint32_t points;
+};
+
+/**
+ * @brief Statistic measurements data structure
+ */
+struct StatisticData
+{
+    float max;
+    float min;
+    float mean;
+    float deviation;
+};
+#pragma pack(pop)
+
+#endif // PACKETS_H
@@ -1,153 +1,309 @@
 #include "parser.h"
 
+#include <charconv>
+#include <cmath>
+#include <vector>
+
 #include <QByteArray>
+#include <QDateTime>
 #include <QDebug>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QTimeZone>
 
+#include "packets.h"
+#include "rawseries.h"
+
 namespace
 {
-using PsdPoint = float;
-
 /**
- * @brief Data type identifiers
+ * @brief Streaming JSON writer, appends formatted text directly to the output buffer
+ * Formatting matches QJsonDocument output, keys must be written in alphabetical order as QJsonObject does
  */
-enum class DataType
+class JsonWriter
 {
-    Psd,
-    Statistic,
-    Raw,
+public:
+    JsonWriter(QByteArray &json, bool compact)
+        : json(json)
+        , compact(compact)
+    {
+    }
 
-    Count
-};
+    void beginObject(const char *key = nullptr)
+    {
+        beginValue(key);
+        json += '{';
+        push();
+    }
 
-#pragma pack(push, 1)
-/**
- * @brief Single measurements packet header structure
- */
-struct PacketHeader
-{
-    uint32_t startEpochTime;
-    uint32_t durationMs;
-    uint16_t sampleTimeMs;
-    uint8_t dataType;
-    uint8_t sensorType;
+    void endObject()
+    {
+        pop('}');
+    }
 
-    QJsonObject toJson()
+    void beginArray(const char *key = nullptr)
     {
-        QJsonObject json;
+        beginValue(key);
+        json += '[';
+        push();
+    }
 
-        auto startDateTime = QDateTime::fromSecsSinceEpoch(startEpochTime, QTimeZone::utc());
-        json["start time"] = startDateTime.toString("yyyy-MM-dd hh:mm:ss");
-        json["duration ms"] = static_cast<int>(durationMs);
-        json["sample time ms"] = static_cast<int>(sampleTimeMs);
+    void endArray()
+    {
+        pop(']');
+    }
 
-        return json;
+    void value(const char *key, double number)
+    {
+        beginValue(key);
+        if (std::isfinite(number) == false)
+        {
+            // JSON has no NaN and infinity, QJsonDocument writes them as null as well
+            json += "null";
+            return;
+        }
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        json.append(buffer, result.ptr - buffer);
     }
-};
 
-/**
- * @brief PSD measurements header structure
- */
-struct PsdHeader
-{
-    float coreFrequency;
-    float coreAmplitude;
-    float deltaFrequency;
-    uint32_t points;
+    void value(const char *key, uint32_t number)
+    {
+        beginValue(key);
+        char buffer[16];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        json.append(buffer, result.ptr - buffer);
+    }
 
-    QJsonObject toJson()
+    void value(const char *key, int32_t number)
     {
-        QJsonObject json;
+        beginValue(key);
+        char buffer[16];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        json.append(buffer, result.ptr - buffer);
+    }
 
-        json["core freq"] = coreFrequency;
-        json["core ampl"] = coreAmplitude;
-        json["delta freq"] = deltaFrequency;
-        json["points"] = static_cast<int>(points);
+    void value(const char *key, const QByteArray &string)
+    {
+        // Only plain ASCII strings are written, no escaping required
+        beginValue(key);
+        json += '"';
+        json += string;
+        json += '"';
+    }
 
-        return json;
+    void finish()
+    {
+        if (compact == false)
+        {
+            json += '\n';
+        }
     }
-};
 
-/**
- * @brief Statistic measurements data structure
- */
-struct StatisticData
-{
-    float max;
-    float min;
-    float mean;
-    float deviation;
+private:
+    static constexpr int depthMax = 8;
 
-    QJsonObject toJson()
+    void beginValue(const char *key)
     {
-        QJsonObject json;
+        if (depth > 0)
+        {
+            if (hasItems[depth - 1] == true)
+            {
+                json += ',';
+            }
+            hasItems[depth - 1] = true;
+
+            if (compact == false)
+            {
+                json += '\n';
+                indent(depth);
+            }
+        }
+
+        if (key != nullptr)
+        {
+            json += '"';
+            json += key;
+            json += compact ? "\":" : "\": ";
+        }
+    }
 
-        json["max"] = max;
-        json["min"] = min;
-        json["mean"] = mean;
-        json["deviation"] = deviation;
+    void push()
+    {
+        Q_ASSERT(depth < depthMax);
+        hasItems[depth++] = false;
+    }
+
+    void pop(char closing)
+    {
+        depth--;
+        if (compact == false)
+        {
+            json += '\n';
+            indent(depth);
+        }
+        json += closing;
+    }
 
-        return json;
+    void indent(int level)
+    {
+        json.append(level * 4, ' ');
     }
+
+    QByteArray &json;
+    bool compact;
+    int depth = 0;
+    bool hasItems[depthMax] = {};
 };
-#pragma pack(pop)
 
-bool psdToJson(const QByteArray &rawData, QJsonObject &json)
+void packetHeaderToJson(const PacketHeader &packetHeader, JsonWriter &writer)
+{
+    auto startDateTime = QDateTime::fromSecsSinceEpoch(packetHeader.startEpochTime, QTimeZone::utc());
+
+    writer.beginObject("packet header");
+    writer.value("duration ms", packetHeader.durationMs);
+    writer.value("sample time ms", static_cast<uint32_t>(packetHeader.sampleTimeMs));
+    writer.value("start time", startDateTime.toString("yyyy-MM-dd hh:mm:ss").toLatin1());
+    writer.endObject();
+}
+
+void psdHeaderToJson(const PsdHeader &psdHeader, JsonWriter &writer)
+{
+    writer.beginObject("psd header");
+    writer.value("core ampl", psdHeader.coreAmplitude);
+    writer.value("core freq", psdHeader.coreFrequency);
+    writer.value("delta freq", psdHeader.deltaFrequency);
+    writer.value("points", psdHeader.points);
+    writer.endObject();
+}
+
+void psdAnalysisToJson(const PsdAnalysis::Result &result, JsonWriter &writer)
+{
+    writer.beginObject("psd analysis");
+    writer.beginArray("band power");
+    for (float bandPower : result.bandPowers)
+    {
+        writer.value(nullptr, bandPower);
+    }
+    writer.endArray();
+    writer.value("peak ampl", result.peakAmplitude);
+    writer.value("peak db", result.peakDecibels);
+    writer.value("peak freq", result.peakFrequency);
+    writer.value("total power", result.totalPower);
+    writer.endObject();
+}
+
+void statisticDataToJson(const StatisticData &statisticData, JsonWriter &writer)
 {
-    if (rawData.size() < static_cast<qsizetype>(sizeof(PsdHeader)))
+    writer.beginObject("statistic");
+    writer.value("deviation", statisticData.deviation);
+    writer.value("max", statisticData.max);
+    writer.value("mean", statisticData.mean);
+    writer.value("min", statisticData.min);
+    writer.endObject();
+}
+
+// Approximate size of single formatted PSD point to reserve output buffer
+constexpr qsizetype psdPointJsonSize = 80;
+
+bool psdToJson(const char *data, qsizetype size, JsonWriter &writer, QByteArray &jsonData,
+               const PsdAnalysis::Settings *psdAnalysis)
+{
+    if (size < static_cast<qsizetype>(sizeof(PsdHeader)))
     {
-        qCritical() << "Psd data size" << rawData.size() << "is too small";
+        qCritical() << "Psd data size" << size << "is too small";
         return false;
     }
 
     PsdHeader psdHeader;
-    memcpy(&psdHeader, rawData.constData(), sizeof(PsdHeader));
-    const QByteArray psdPointsData = rawData.sliced(sizeof(PsdHeader));
-    if (psdPointsData.size() != static_cast<qsizetype>(psdHeader.points * sizeof(PsdPoint)))
+    memcpy(&psdHeader, data, sizeof(PsdHeader));
+    const qsizetype psdPointsSize = size - sizeof(PsdHeader);
+    if (psdPointsSize != static_cast<qsizetype>(psdHeader.points * sizeof(PsdPoint)))
     {
-        qCritical() << "Psd points size" << psdPointsData.size() << "!= points count" << psdHeader.points;
+        qCritical() << "Psd points size" << psdPointsSize << "!= points count" << psdHeader.points;
         return false;
     }
 
-    float frequency = 0;
-    QJsonArray psdPointsJson;
-    const PsdPoint *psdPoints = reinterpret_cast<const PsdPoint*>(psdPointsData.constData());
+    jsonData.reserve(jsonData.size() + psdHeader.points * psdPointJsonSize);
+
+    // Points are read in place, data is not guaranteed to be aligned for float access
+    const char *psdPoints = data + sizeof(PsdHeader);
+
+    std::vector<float> decibels;
+    if (psdAnalysis != nullptr)
+    {
+        psdAnalysisToJson(PsdAnalysis::analyze(psdHeader, psdPoints, *psdAnalysis), writer);
+        if (psdAnalysis->isDecibels == true)
+        {
+            decibels.resize(psdHeader.points);
+            PsdAnalysis::toDecibels(psdPoints, psdHeader.points, decibels.data());
+        }
+    }
+
+    psdHeaderToJson(psdHeader, writer);
+
+    writer.beginArray("psd points");
     for (size_t idx = 0; idx < psdHeader.points; idx++)
     {
-        QJsonObject pointJson;
+        PsdPoint amplitude;
+        memcpy(&amplitude, psdPoints + idx * sizeof(PsdPoint), sizeof(PsdPoint));
+
+        writer.beginObject();
+        writer.value("ampl", amplitude);
+        if (decibels.empty() == false)
+        {
+            writer.value("ampl db", decibels[idx]);
+        }
+        // Frequency isn't accumulated, so rounding errors don't grow with the point index
+        writer.value("freq", static_cast<float>(idx) * psdHeader.deltaFrequency);
+        writer.endObject();
+    }
+    writer.endArray();
+
+    return true;
+}
+
+// Approximate size of single formatted raw sample to reserve output buffer
+constexpr qsizetype rawSampleJsonSize = 16;
+
+bool rawToJson(const QByteArray &rawData, JsonWriter &writer, QByteArray &jsonData)
+{
+    // Samples are read from the packet in place
+    RawSeries series;
+    bool result = series.assign(rawData);
+    if (result == false)
+    {
+        return false;
+    }
 
-        pointJson["ampl"] = psdPoints[idx];
-        pointJson["freq"] = frequency;
+    jsonData.reserve(jsonData.size() + series.sampleCount() * rawSampleJsonSize);
 
-        psdPointsJson.append(pointJson);
-        frequency += psdHeader.deltaFrequency;
+    writer.beginArray("raw samples");
+    for (qsizetype idx = 0; idx < series.sampleCount(); idx++)
+    {
+        writer.value(nullptr, static_cast<int32_t>(series.sample(idx)));
     }
+    writer.endArray();
 
-    json["psd header"] = psdHeader.toJson();
-    json["psd points"] = psdPointsJson;
     return true;
 }
 
-bool statisticToJson(const QByteArray &rawData, QJsonObject &json)
+bool statisticToJson(const char *data, qsizetype size, JsonWriter &writer)
 {
-    if (rawData.size() < static_cast<qsizetype>(sizeof(StatisticData)))
+    if (size < static_cast<qsizetype>(sizeof(StatisticData)))
     {
-        qCritical() << "Statistic data size" << rawData.size() << "is too small";
+        qCritical() << "Statistic data size" << size << "is too small";
         return false;
     }
 
     StatisticData statisticData;
-    memcpy(&statisticData, rawData.constData(), sizeof(StatisticData));
+    memcpy(&statisticData, data, sizeof(StatisticData));
 
-    json["statistic"] = statisticData.toJson();
+    statisticDataToJson(statisticData, writer);
     return true;
 }
 }
 
-bool Parser::toJson(const QByteArray &rawData, QByteArray &jsonData)
+bool Parser::toJson(const QByteArray &rawData, QByteArray &jsonData, JsonFormat format,
+                    const PsdAnalysis::Settings *psdAnalysis)
 {
     if (rawData.size() < static_cast<qsizetype>(sizeof(PacketHeader)))
     {
@@ -159,19 +315,27 @@ bool Parser::toJson(const QByteArray &rawData, QByteArray &jsonData)
     memcpy(&packetHeader, rawData.constData(), sizeof(packetHeader));
 
     bool result = false;
-    const QByteArray packetPayload = rawData.sliced(sizeof(PacketHeader));
+    const char *packetPayload = rawData.constData() + sizeof(PacketHeader);
+    const qsizetype packetPayloadSize = rawData.size() - sizeof(PacketHeader);
 
-    QJsonObject json;
-    json["packet header"] = packetHeader.toJson();
+    // JSON is appended to the output, so caller is able to reuse its buffer
+    const qsizetype jsonStartSize = jsonData.size();
+    JsonWriter writer(jsonData, format == JsonFormat::Compact);
+    writer.beginObject();
+    packetHeaderToJson(packetHeader, writer);
 
     switch (packetHeader.dataType)
     {
     case static_cast<uint8_t>(DataType::Psd):
-        result = psdToJson(packetPayload, json);
+        result = psdToJson(packetPayload, packetPayloadSize, writer, jsonData, psdAnalysis);
         break;
 
     case static_cast<uint8_t>(DataType::Statistic):
-        result = statisticToJson(packetPayload, json);
+        result = statisticToJson(packetPayload, packetPayloadSize, writer);
+        break;
+
+    case static_cast<uint8_t>(DataType::Raw):
+        result = rawToJson(rawData, writer, jsonData);
         break;
 
     default:
@@ -180,9 +344,77 @@ bool Parser::toJson(const QByteArray &rawData, QByteArray &jsonData)
 
     if (result == true)
     {
-        QJsonDocument jsonDoc(json);
-        jsonData = jsonDoc.toJson(QJsonDocument::Indented);
+        writer.endObject();
+        writer.finish();
+    }
+    else
+    {
+        // Drop partially written packet
+        jsonData.truncate(jsonStartSize);
     }
 
     return result;
 }
+
+QString Parser::toSummary(const QByteArray &rawData)
+{
+    if (rawData.size() < static_cast<qsizetype>(sizeof(PacketHeader)))
+    {
+        return QString("invalid packet, %1 bytes").arg(rawData.size());
+    }
+
+    PacketHeader packetHeader;
+    memcpy(&packetHeader, rawData.constData(), sizeof(packetHeader));
+
+    const char *packetPayload = rawData.constData() + sizeof(PacketHeader);
+    const qsizetype packetPayloadSize = rawData.size() - sizeof(PacketHeader);
+
+    auto startDateTime = QDateTime::fromSecsSinceEpoch(packetHeader.startEpochTime, QTimeZone::utc());
+    QString summary = startDateTime.toString("yyyy-MM-dd hh:mm:ss") + ", " +
+                      QString::number(packetHeader.durationMs) + " ms, ";
+
+    switch (packetHeader.dataType)
+    {
+    case static_cast<uint8_t>(DataType::Psd):
+        if (packetPayloadSize >= static_cast<qsizetype>(sizeof(PsdHeader)))
+        {
+            PsdHeader psdHeader;
+            memcpy(&psdHeader, packetPayload, sizeof(PsdHeader));
+            summary += QString("PSD %1 points, core %2 Hz ampl %3")
+                           .arg(psdHeader.points)
+                           .arg(psdHeader.coreFrequency, 0, 'g', 4)
+                           .arg(psdHeader.coreAmplitude, 0, 'g', 4);
+            return summary;
+        }
+        break;
+
+    case static_cast<uint8_t>(DataType::Statistic):
+        if (packetPayloadSize >= static_cast<qsizetype>(sizeof(StatisticData)))
+        {
+            StatisticData statisticData;
+            memcpy(&statisticData, packetPayload, sizeof(StatisticData));
+            summary += QString("statistic mean %1 min %2 max %3")
+                           .arg(statisticData.mean, 0, 'g', 4)
+                           .arg(statisticData.min, 0, 'g', 4)
+                           .arg(statisticData.max, 0, 'g', 4);
+            return summary;
+        }
+        break;
+
+    case static_cast<uint8_t>(DataType::Raw):
+        if (packetPayloadSize == RawSeries::expectedSize(packetHeader))
+        {
+            summary += QString("raw %1 samples, sample time %2 ms")
+                           .arg(packetPayloadSize / static_cast<qsizetype>(sizeof(RawSample)))
+                           .arg(packetHeader.sampleTimeMs);
+            return summary;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    summary += QString("data type %1, %2 bytes").arg(packetHeader.dataType).arg(packetPayloadSize);
+    return summary;
+}
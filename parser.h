@@ -2,11 +2,25 @@
 #define PARSER_H
 
 #include <QByteArray>
+#include <QString>
+
+#include "psdanalysis.h"
 
 class Parser
 {
 public:
-    static bool toJson(const QByteArray &rawData, QByteArray &jsonData);
+    /**
+     * @brief JSON output formatting
+     */
+    enum class JsonFormat
+    {
+        Indented,
+        Compact,
+    };
+
+    static bool toJson(const QByteArray &rawData, QByteArray &jsonData, JsonFormat format = JsonFormat::Indented,
+                       const PsdAnalysis::Settings *psdAnalysis = nullptr);
+    static QString toSummary(const QByteArray &rawData);
 };
 
 #endif // PARSER_H
@@ -0,0 +1,451 @@
+#include "psdanalysis.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include <QDebug>
+#include <QStringList>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+// AVX2 kernels are compiled for AVX2 only and selected when CPU supports it
+#define PSD_ANALYSIS_AVX2 __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#define PSD_ANALYSIS_AVX2
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PSD_ANALYSIS_NEON
+#endif
+
+namespace
+{
+constexpr float decibelsPerNeper = 4.342944819f;
+constexpr float ln2 = 0.693147181f;
+constexpr float sqrt2 = 1.414213562f;
+constexpr uint32_t mantissaMask = 0x007FFFFF;
+constexpr uint32_t exponentOne = 0x3F800000;
+constexpr int exponentBias = 127;
+
+float loadPoint(const char *points, qsizetype idx)
+{
+    PsdPoint amplitude;
+    memcpy(&amplitude, points + idx * sizeof(PsdPoint), sizeof(PsdPoint));
+    return amplitude;
+}
+
+/**
+ * @brief Logarithm is split to exponent and mantissa in [sqrt(2)/2, sqrt(2)),
+ * ln(mantissa) is taken by atanh series which is exact to float precision there.
+ * Vector kernels do exactly the same steps.
+ */
+float scalarDecibels(float amplitude)
+{
+    // Zero, negative noise and NaN are clamped to the smallest normal value
+    const float value = (amplitude > FLT_MIN) ? amplitude : FLT_MIN;
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int32_t exponent = static_cast<int32_t>(bits >> 23) - exponentBias;
+    bits = (bits & mantissaMask) | exponentOne;
+    float mantissa;
+    memcpy(&mantissa, &bits, sizeof(mantissa));
+    if (mantissa > sqrt2)
+    {
+        mantissa *= 0.5f;
+        exponent++;
+    }
+
+    const float t = (mantissa - 1) / (mantissa + 1);
+    const float t2 = t * t;
+    const float series = ((t2 * (1.0f / 7) + 1.0f / 5) * t2 + 1.0f / 3) * t2 + 1;
+    const float logarithm = (2 * t) * series + static_cast<float>(exponent) * ln2;
+    return logarithm * decibelsPerNeper;
+}
+
+float scalarSum(const char *points, qsizetype count)
+{
+    double sum = 0;
+    for (qsizetype idx = 0; idx < count; idx++)
+    {
+        sum += loadPoint(points, idx);
+    }
+    return static_cast<float>(sum);
+}
+
+qsizetype scalarPeak(const char *points, qsizetype count)
+{
+    // First maximum is taken, NaN points are ignored
+    qsizetype peakIdx = 0;
+    float peakValue = -INFINITY;
+    for (qsizetype idx = 0; idx < count; idx++)
+    {
+        const float value = loadPoint(points, idx);
+        if (value > peakValue)
+        {
+            peakValue = value;
+            peakIdx = idx;
+        }
+    }
+    return peakIdx;
+}
+
+void scalarDecibels(const char *points, qsizetype count, float *decibels)
+{
+    for (qsizetype idx = 0; idx < count; idx++)
+    {
+        decibels[idx] = scalarDecibels(loadPoint(points, idx));
+    }
+}
+
+qsizetype firstLane(unsigned mask)
+{
+    qsizetype lane = 0;
+    while ((mask & 1) == 0)
+    {
+        mask >>= 1;
+        lane++;
+    }
+    return lane;
+}
+
+qsizetype findValue(const char *points, qsizetype from, qsizetype count, float value)
+{
+    for (qsizetype idx = from; idx < count; idx++)
+    {
+        if (loadPoint(points, idx) == value)
+        {
+            return idx;
+        }
+    }
+    return 0;
+}
+
+#ifdef PSD_ANALYSIS_AVX2
+PSD_ANALYSIS_AVX2 const float *avx2Points(const char *points, qsizetype idx)
+{
+    return reinterpret_cast<const float*>(points + idx * sizeof(PsdPoint));
+}
+
+PSD_ANALYSIS_AVX2 float avx2Sum(const char *points, qsizetype count)
+{
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    qsizetype idx = 0;
+    for (; idx + 16 <= count; idx += 16)
+    {
+        sum0 = _mm256_add_ps(sum0, _mm256_loadu_ps(avx2Points(points, idx)));
+        sum1 = _mm256_add_ps(sum1, _mm256_loadu_ps(avx2Points(points, idx + 8)));
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, _mm256_add_ps(sum0, sum1));
+    double sum = 0;
+    for (float lane : lanes)
+    {
+        sum += lane;
+    }
+    return static_cast<float>(sum + scalarSum(points + idx * sizeof(PsdPoint), count - idx));
+}
+
+PSD_ANALYSIS_AVX2 qsizetype avx2Peak(const char *points, qsizetype count)
+{
+    // Maximum is found first, then the first point equal to it
+    __m256 peak = _mm256_set1_ps(-INFINITY);
+    qsizetype idx = 0;
+    for (; idx + 8 <= count; idx += 8)
+    {
+        // NaN point keeps the second operand
+        peak = _mm256_max_ps(_mm256_loadu_ps(avx2Points(points, idx)), peak);
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, peak);
+    float peakValue = -INFINITY;
+    for (float lane : lanes)
+    {
+        peakValue = (lane > peakValue) ? lane : peakValue;
+    }
+    for (; idx < count; idx++)
+    {
+        const float value = loadPoint(points, idx);
+        peakValue = (value > peakValue) ? value : peakValue;
+    }
+
+    const __m256 target = _mm256_set1_ps(peakValue);
+    for (idx = 0; idx + 8 <= count; idx += 8)
+    {
+        const int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(avx2Points(points, idx)), target, _CMP_EQ_OQ));
+        if (mask != 0)
+        {
+            return idx + firstLane(static_cast<unsigned>(mask));
+        }
+    }
+    return findValue(points, idx, count, peakValue);
+}
+
+PSD_ANALYSIS_AVX2 void avx2Decibels(const char *points, qsizetype count, float *decibels)
+{
+    const __m256 minValue = _mm256_set1_ps(FLT_MIN);
+    const __m256i mantissaMaskValue = _mm256_set1_epi32(mantissaMask);
+    const __m256i exponentOneValue = _mm256_set1_epi32(exponentOne);
+    const __m256i exponentBiasValue = _mm256_set1_epi32(exponentBias);
+    const __m256 one = _mm256_set1_ps(1);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 two = _mm256_set1_ps(2);
+    const __m256 sqrt2Value = _mm256_set1_ps(sqrt2);
+
+    qsizetype idx = 0;
+    for (; idx + 8 <= count; idx += 8)
+    {
+        const __m256 value = _mm256_max_ps(_mm256_loadu_ps(avx2Points(points, idx)), minValue);
+
+        const __m256i bits = _mm256_castps_si256(value);
+        __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), exponentBiasValue);
+        __m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, mantissaMaskValue), exponentOneValue));
+        const __m256 isAbove = _mm256_cmp_ps(mantissa, sqrt2Value, _CMP_GT_OQ);
+        mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, half), isAbove);
+        // Mask lanes are -1
+        exponent = _mm256_sub_epi32(exponent, _mm256_castps_si256(isAbove));
+
+        const __m256 t = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+        const __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 series = _mm256_add_ps(_mm256_mul_ps(t2, _mm256_set1_ps(1.0f / 7)), _mm256_set1_ps(1.0f / 5));
+        series = _mm256_add_ps(_mm256_mul_ps(series, t2), _mm256_set1_ps(1.0f / 3));
+        series = _mm256_add_ps(_mm256_mul_ps(series, t2), one);
+        const __m256 logarithm = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(two, t), series),
+                                               _mm256_mul_ps(_mm256_cvtepi32_ps(exponent), _mm256_set1_ps(ln2)));
+        _mm256_storeu_ps(decibels + idx, _mm256_mul_ps(logarithm, _mm256_set1_ps(decibelsPerNeper)));
+    }
+
+    scalarDecibels(points + idx * sizeof(PsdPoint), count - idx, decibels + idx);
+}
+
+bool hasAvx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return true;
+#endif
+}
+#endif
+
+#ifdef PSD_ANALYSIS_NEON
+const float *neonPoints(const char *points, qsizetype idx)
+{
+    return reinterpret_cast<const float*>(points + idx * sizeof(PsdPoint));
+}
+
+float neonSum(const char *points, qsizetype count)
+{
+    float32x4_t sum0 = vdupq_n_f32(0);
+    float32x4_t sum1 = vdupq_n_f32(0);
+    qsizetype idx = 0;
+    for (; idx + 8 <= count; idx += 8)
+    {
+        sum0 = vaddq_f32(sum0, vld1q_f32(neonPoints(points, idx)));
+        sum1 = vaddq_f32(sum1, vld1q_f32(neonPoints(points, idx + 4)));
+    }
+
+    const double sum = vaddvq_f32(vaddq_f32(sum0, sum1));
+    return static_cast<float>(sum + scalarSum(points + idx * sizeof(PsdPoint), count - idx));
+}
+
+qsizetype neonPeak(const char *points, qsizetype count)
+{
+    // Maximum is found first, then the first point equal to it
+    float32x4_t peak = vdupq_n_f32(-INFINITY);
+    qsizetype idx = 0;
+    for (; idx + 4 <= count; idx += 4)
+    {
+        // NaN point is ignored by maxNum
+        peak = vmaxnmq_f32(peak, vld1q_f32(neonPoints(points, idx)));
+    }
+
+    float peakValue = vmaxvq_f32(peak);
+    for (; idx < count; idx++)
+    {
+        const float value = loadPoint(points, idx);
+        peakValue = (value > peakValue) ? value : peakValue;
+    }
+
+    const float32x4_t target = vdupq_n_f32(peakValue);
+    for (idx = 0; idx + 4 <= count; idx += 4)
+    {
+        if (vmaxvq_u32(vceqq_f32(vld1q_f32(neonPoints(points, idx)), target)) != 0)
+        {
+            return findValue(points, idx, count, peakValue);
+        }
+    }
+    return findValue(points, idx, count, peakValue);
+}
+
+void neonDecibels(const char *points, qsizetype count, float *decibels)
+{
+    const float32x4_t minValue = vdupq_n_f32(FLT_MIN);
+    const uint32x4_t mantissaMaskValue = vdupq_n_u32(mantissaMask);
+    const uint32x4_t exponentOneValue = vdupq_n_u32(exponentOne);
+    const int32x4_t exponentBiasValue = vdupq_n_s32(exponentBias);
+    const float32x4_t one = vdupq_n_f32(1);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t two = vdupq_n_f32(2);
+    const float32x4_t sqrt2Value = vdupq_n_f32(sqrt2);
+
+    qsizetype idx = 0;
+    for (; idx + 4 <= count; idx += 4)
+    {
+        // MaxNum clamps NaN as well
+        const float32x4_t value = vmaxnmq_f32(vld1q_f32(neonPoints(points, idx)), minValue);
+
+        const uint32x4_t bits = vreinterpretq_u32_f32(value);
+        int32x4_t exponent = vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), exponentBiasValue);
+        float32x4_t mantissa = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, mantissaMaskValue), exponentOneValue));
+        const uint32x4_t isAbove = vcgtq_f32(mantissa, sqrt2Value);
+        mantissa = vbslq_f32(isAbove, vmulq_f32(mantissa, half), mantissa);
+        // Mask lanes are -1
+        exponent = vsubq_s32(exponent, vreinterpretq_s32_u32(isAbove));
+
+        const float32x4_t t = vdivq_f32(vsubq_f32(mantissa, one), vaddq_f32(mantissa, one));
+        const float32x4_t t2 = vmulq_f32(t, t);
+        float32x4_t series = vaddq_f32(vmulq_f32(t2, vdupq_n_f32(1.0f / 7)), vdupq_n_f32(1.0f / 5));
+        series = vaddq_f32(vmulq_f32(series, t2), vdupq_n_f32(1.0f / 3));
+        series = vaddq_f32(vmulq_f32(series, t2), one);
+        const float32x4_t logarithm = vaddq_f32(vmulq_f32(vmulq_f32(two, t), series),
+                                                vmulq_f32(vcvtq_f32_s32(exponent), vdupq_n_f32(ln2)));
+        vst1q_f32(decibels + idx, vmulq_f32(logarithm, vdupq_n_f32(decibelsPerNeper)));
+    }
+
+    scalarDecibels(points + idx * sizeof(PsdPoint), count - idx, decibels + idx);
+}
+#endif
+
+/**
+ * @brief Kernels of the instruction set selected once for the running CPU
+ */
+struct Kernels
+{
+    const char *instructionSet = "scalar";
+    float (*sum)(const char*, qsizetype) = scalarSum;
+    qsizetype (*peak)(const char*, qsizetype) = scalarPeak;
+    void (*toDecibels)(const char*, qsizetype, float*) = scalarDecibels;
+};
+
+Kernels selectKernels()
+{
+    Kernels kernels;
+#if defined(PSD_ANALYSIS_AVX2)
+    if (hasAvx2() == true)
+    {
+        kernels = {"AVX2", avx2Sum, avx2Peak, avx2Decibels};
+    }
+#elif defined(PSD_ANALYSIS_NEON)
+    kernels = {"NEON", neonSum, neonPeak, neonDecibels};
+#endif
+    qDebug() << "PSD analysis kernels:" << kernels.instructionSet;
+    return kernels;
+}
+
+const Kernels &kernels()
+{
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+}
+
+bool PsdAnalysis::parseBands(const QString &text, QList<Band> &bands)
+{
+    // Bands are listed as "from-to" in Hz separated by commas, e.g. "0-100, 100-1000"
+    bands.clear();
+    const QStringList items = text.split(',', Qt::SkipEmptyParts);
+    for (const QString &item : items)
+    {
+        const QStringList bounds = item.trimmed().split('-');
+        if (bounds.size() != 2)
+        {
+            qWarning() << "Invalid PSD band" << item;
+            return false;
+        }
+
+        bool isFromValid = false;
+        bool isToValid = false;
+        Band band;
+        band.fromFrequency = bounds.at(0).trimmed().toFloat(&isFromValid);
+        band.toFrequency = bounds.at(1).trimmed().toFloat(&isToValid);
+        if (isFromValid == false || isToValid == false || band.fromFrequency > band.toFrequency)
+        {
+            qWarning() << "Invalid PSD band" << item;
+            return false;
+        }
+
+        bands.append(band);
+    }
+
+    return true;
+}
+
+PsdAnalysis::Result PsdAnalysis::analyze(const PsdHeader &psdHeader, const char *points, const Settings &settings)
+{
+    Result result;
+
+    const qsizetype count = psdHeader.points;
+    const float deltaFrequency = psdHeader.deltaFrequency;
+    if (count > 0)
+    {
+        result.totalPower = sum(points, count) * deltaFrequency;
+
+        const qsizetype peakIdx = peak(points, count);
+        result.peakAmplitude = loadPoint(points, peakIdx);
+        result.peakFrequency = static_cast<float>(peakIdx) * deltaFrequency;
+        result.peakDecibels = toDecibels(result.peakAmplitude);
+    }
+
+    result.bandPowers.reserve(settings.bands.size());
+    for (const Band &band : settings.bands)
+    {
+        float bandPower = 0;
+        if (count > 0 && deltaFrequency > 0)
+        {
+            // Points whose frequency is within the band
+            const double fromIdx = std::max(std::ceil(band.fromFrequency / static_cast<double>(deltaFrequency)), 0.0);
+            const double toIdx = std::min(std::floor(band.toFrequency / static_cast<double>(deltaFrequency)),
+                                          static_cast<double>(count - 1));
+            if (toIdx >= fromIdx)
+            {
+                const qsizetype from = static_cast<qsizetype>(fromIdx);
+                bandPower = sum(points + from * sizeof(PsdPoint), static_cast<qsizetype>(toIdx) - from + 1) * deltaFrequency;
+            }
+        }
+        result.bandPowers.append(bandPower);
+    }
+
+    return result;
+}
+
+float PsdAnalysis::sum(const char *points, qsizetype count)
+{
+    return kernels().sum(points, count);
+}
+
+qsizetype PsdAnalysis::peak(const char *points, qsizetype count)
+{
+    return kernels().peak(points, count);
+}
+
+void PsdAnalysis::toDecibels(const char *points, qsizetype count, float *decibels)
+{
+    kernels().toDecibels(points, count, decibels);
+}
+
+float PsdAnalysis::toDecibels(float amplitude)
+{
+    return scalarDecibels(amplitude);
+}
+
+const char *PsdAnalysis::instructionSet()
+{
+    return kernels().instructionSet;
+}
@@ -0,0 +1,54 @@
+#ifndef PSDANALYSIS_H
+#define PSDANALYSIS_H
+
+#include <QList>
+#include <QString>
+
+#include "packets.h"
+
+/**
+ * @brief PSD post-processing: band power, peak search and conversion to dB
+ * Kernels work on the packet points in place and use AVX2 or NEON when available,
+ * the scalar fallback gives the same results up to float rounding. Frequency of point idx is idx * deltaFrequency.
+ */
+class PsdAnalysis
+{
+public:
+    /**
+     * @brief Frequency band, both bounds are included
+     */
+    struct Band
+    {
+        float fromFrequency = 0;
+        float toFrequency = 0;
+    };
+
+    struct Settings
+    {
+        QList<Band> bands;
+        // Amplitude of every point is also written in dB
+        bool isDecibels = false;
+    };
+
+    struct Result
+    {
+        float totalPower = 0;
+        float peakFrequency = 0;
+        float peakAmplitude = 0;
+        float peakDecibels = 0;
+        QList<float> bandPowers;
+    };
+
+    static bool parseBands(const QString &text, QList<Band> &bands);
+    static Result analyze(const PsdHeader &psdHeader, const char *points, const Settings &settings);
+
+    // Points may be unaligned, count is the number of PsdPoint values
+    static float sum(const char *points, qsizetype count);
+    static qsizetype peak(const char *points, qsizetype count);
+    static void toDecibels(const char *points, qsizetype count, float *decibels);
+    static float toDecibels(float amplitude);
+
+    static const char *instructionSet();
+};
+
+#endif // PSDANALYSIS_H
@@ -0,0 +1,161 @@
+#include "rawseries.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#include <QDebug>
+
+namespace
+{
+// Longest CSV line: epoch milliseconds, sensor type and sample with separators
+constexpr qsizetype csvLineSizeMax = 20 + 1 + 3 + 1 + 6 + 1;
+}
+
+bool RawSeries::assign(const QByteArray &rawData)
+{
+    if (rawData.size() < static_cast<qsizetype>(sizeof(PacketHeader)))
+    {
+        qCritical() << "Data packet size" << rawData.size() << "is too small";
+        return false;
+    }
+
+    memcpy(&packetHeader, rawData.constData(), sizeof(PacketHeader));
+    if (packetHeader.dataType != static_cast<uint8_t>(DataType::Raw))
+    {
+        qCritical() << "Data type" << packetHeader.dataType << "isn't Raw time series";
+        return false;
+    }
+
+    const qsizetype payloadSize = rawData.size() - sizeof(PacketHeader);
+    if (payloadSize != expectedSize(packetHeader))
+    {
+        qCritical() << "Raw data size" << payloadSize << "doesn't match duration" << packetHeader.durationMs
+                    << "ms and sample time" << packetHeader.sampleTimeMs << "ms";
+        return false;
+    }
+
+    samples = rawData.constData() + sizeof(PacketHeader);
+    count = payloadSize / static_cast<qsizetype>(sizeof(RawSample));
+    return true;
+}
+
+const PacketHeader &RawSeries::header() const
+{
+    return packetHeader;
+}
+
+qsizetype RawSeries::sampleCount() const
+{
+    return count;
+}
+
+RawSample RawSeries::sample(qsizetype index) const
+{
+    // Samples are read in place, data is not guaranteed to be aligned
+    RawSample value;
+    memcpy(&value, samples + index * sizeof(RawSample), sizeof(RawSample));
+    return value;
+}
+
+qsizetype RawSeries::decimatedCount(int factor) const
+{
+    return (count + factor - 1) / factor;
+}
+
+void RawSeries::decimate(int factor, char *output) const
+{
+    if (factor <= 1)
+    {
+        memcpy(output, samples, count * sizeof(RawSample));
+        return;
+    }
+
+    for (qsizetype first = 0; first < count; first += factor)
+    {
+        const qsizetype last = std::min<qsizetype>(first + factor, count);
+        int32_t sum = 0;
+        for (qsizetype index = first; index < last; index++)
+        {
+            sum += sample(index);
+        }
+
+        // Average is rounded half away from zero
+        const int32_t size = static_cast<int32_t>(last - first);
+        const RawSample average = static_cast<RawSample>((sum + (sum >= 0 ? size / 2 : -size / 2)) / size);
+        memcpy(output, &average, sizeof(average));
+        output += sizeof(average);
+    }
+}
+
+void RawSeries::appendBinary(QByteArray &output, int factor) const
+{
+    RawSeriesRecord record = {};
+    record.startEpochTime = packetHeader.startEpochTime;
+    record.durationMs = packetHeader.durationMs;
+    record.sampleTimeMs = static_cast<uint32_t>(packetHeader.sampleTimeMs) * factor;
+    record.sampleCount = static_cast<uint32_t>(decimatedCount(factor));
+    record.sensorType = packetHeader.sensorType;
+
+    // Samples are written straight to the output buffer
+    const qsizetype start = output.size();
+    output.resize(start + sizeof(record) + record.sampleCount * sizeof(RawSample));
+    memcpy(output.data() + start, &record, sizeof(record));
+    decimate(factor, output.data() + start + sizeof(record));
+}
+
+void RawSeries::appendCsv(QByteArray &output, int factor) const
+{
+    const qsizetype outputCount = decimatedCount(factor);
+    const qsizetype start = output.size();
+    output.resize(start + outputCount * csvLineSizeMax);
+
+    char *line = output.data() + start;
+    char *end = output.data() + output.size();
+    const qint64 startTimeMs = static_cast<qint64>(packetHeader.startEpochTime) * 1000;
+    const qint64 sampleTimeMs = static_cast<qint64>(packetHeader.sampleTimeMs) * factor;
+
+    // Decimated samples are averaged once, not decimated series is read in place
+    QByteArray decimatedData;
+    if (factor > 1)
+    {
+        decimatedData.resize(outputCount * sizeof(RawSample));
+        decimate(factor, decimatedData.data());
+    }
+    const char *values = (factor > 1) ? decimatedData.constData() : samples;
+
+    for (qsizetype index = 0; index < outputCount; index++)
+    {
+        RawSample value;
+        memcpy(&value, values + index * sizeof(RawSample), sizeof(RawSample));
+
+        line = std::to_chars(line, end, startTimeMs + index * sampleTimeMs).ptr;
+        *line++ = ',';
+        line = std::to_chars(line, end, packetHeader.sensorType).ptr;
+        *line++ = ',';
+        line = std::to_chars(line, end, value).ptr;
+        *line++ = '\n';
+    }
+
+    output.truncate(line - output.constData());
+}
+
+qsizetype RawSeries::expectedSize(const PacketHeader &packetHeader)
+{
+    if (packetHeader.sampleTimeMs == 0)
+    {
+        return 0;
+    }
+
+    return static_cast<qsizetype>(packetHeader.durationMs / packetHeader.sampleTimeMs) * sizeof(RawSample);
+}
+
+QByteArray RawSeries::fileHeader()
+{
+    RawSeriesFileHeader header = {};
+    memcpy(header.magic, RawSeriesFileHeader::magicValue, sizeof(header.magic));
+    header.version = RawSeriesFileHeader::versionValue;
+    header.recordSize = sizeof(RawSeriesRecord);
+
+    return QByteArray(reinterpret_cast<const char*>(&header), sizeof(header));
+}
@@ -0,0 +1,71 @@
+#ifndef RAWSERIES_H
+#define RAWSERIES_H
+
+#include <cstdint>
+
+#include <QByteArray>
+
+#include "packets.h"
+
+/**
+ * @brief Raw samples stream file layout, little endian
+ *
+ * "<download>.samples" - RawSeriesFileHeader followed by RawSeriesRecord per packet,
+ * every record is followed by its sampleCount RawSample values
+ */
+struct RawSeriesFileHeader
+{
+    static constexpr char magicValue[8] = {'P', 'S', 'D', 'R', 'A', 'W', 0, 0};
+    static constexpr uint32_t versionValue = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+struct RawSeriesRecord
+{
+    uint32_t startEpochTime;
+    uint32_t durationMs;
+    // Sample time after decimation
+    uint32_t sampleTimeMs;
+    uint32_t sampleCount;
+    uint8_t sensorType;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(RawSeriesFileHeader) == 16, "Unexpected raw series file header size");
+static_assert(sizeof(RawSeriesRecord) == 20, "Unexpected raw series record size");
+
+/**
+ * @brief Samples of Raw packet, refer to the packet data without copying
+ * Packet data must stay unchanged while the series is used.
+ * Decimation averages every factor samples, the last block may be shorter.
+ */
+class RawSeries
+{
+public:
+    static constexpr const char *csvHeader = "time ms,sensor,value\n";
+
+    bool assign(const QByteArray &rawData);
+
+    const PacketHeader &header() const;
+    qsizetype sampleCount() const;
+    RawSample sample(qsizetype index) const;
+
+    qsizetype decimatedCount(int factor) const;
+    void decimate(int factor, char *output) const;
+
+    void appendBinary(QByteArray &output, int factor) const;
+    void appendCsv(QByteArray &output, int factor) const;
+
+    static qsizetype expectedSize(const PacketHeader &packetHeader);
+    static QByteArray fileHeader();
+
+private:
+    PacketHeader packetHeader = {};
+    const char *samples = nullptr;
+    qsizetype count = 0;
+};
+
+#endif // RAWSERIES_H
@@ -1,5 +1,6 @@
 #include "serialport.h"
 
+#include <algorithm>
 #include <chrono>
 
 #include <QDebug>
@@ -7,61 +8,97 @@
 namespace
 {
 constexpr std::chrono::seconds writeTimeout = std::chrono::seconds{5};
+// Queued requests are joined into one device write up to this size
+constexpr qsizetype coalesceSizeMax = 1024;
+constexpr qint64 nsPerUs = 1000;
+// Highest rate of the USB link, higher ones are negotiated by the communicator
+constexpr int baudRateMax = 921600;
 }
 
 SerialPort::SerialPort(QObject *parent)
     : QObject{parent}
     , qSerialPort(new QSerialPort(this))
+    , simulator(new DeviceSimulator(this))
+    , device(qSerialPort)
+    , writeTimer(this)
 {
     connect(qSerialPort, &QSerialPort::errorOccurred, this, &SerialPort::onPortError);
-    connect(qSerialPort, &QSerialPort::bytesWritten, this, &SerialPort::onPortWritten);
-    connect(qSerialPort, &QSerialPort::readyRead, this, &SerialPort::onPortReadData);
+
+    const QList<QIODevice*> devices = {qSerialPort, simulator};
+    for (QIODevice *backend : devices)
+    {
+        connect(backend, &QIODevice::bytesWritten, this, &SerialPort::onPortWritten);
+        connect(backend, &QIODevice::readyRead, this, &SerialPort::onPortReadData);
+    }
+
+    // Simulator options are taken from environment, e.g. DEVICE_SIMULATOR=latency=5,jitter=2,loss=0.0001
+    simulator->setConfig(DeviceSimulator::Config::fromString(qEnvironmentVariable("DEVICE_SIMULATOR")));
 
     writeTimer.setSingleShot(true);
     connect(&writeTimer, &QTimer::timeout, this, &SerialPort::onWriteTimeout);
+
+    txClock.start();
 }
 
 SerialPort::~SerialPort()
 {
     delete qSerialPort;
+    delete simulator;
 }
 
 bool SerialPort::isOpened()
 {
-    return qSerialPort->isOpen();
+    return device->isOpen();
+}
+
+int SerialPort::baudRate()
+{
+    return (device == simulator) ? simulator->baudRate() : qSerialPort->baudRate();
 }
 
 bool SerialPort::open(const QString &portName, int baudRate)
 {
     bool result = false;
 
-    if (qSerialPort->isOpen() == false)
+    if (device->isOpen() == false)
     {
-        if (baudRate > QSerialPort::BaudRate::Baud115200)
+        if (baudRate > baudRateMax)
         {
-            baudRate = QSerialPort::BaudRate::Baud115200;
+            baudRate = baudRateMax;
         }
         else if (baudRate < QSerialPort::BaudRate::Baud1200)
         {
             baudRate = QSerialPort::BaudRate::Baud1200;
         }
 
+        // Port name is kept for logging in simulator mode as well
         qSerialPort->setPortName(portName);
-        qSerialPort->setBaudRate(baudRate);
-        qSerialPort->setDataBits(QSerialPort::Data8);
-        qSerialPort->setParity(QSerialPort::NoParity);
-        qSerialPort->setStopBits(QSerialPort::OneStop);
-        qSerialPort->setFlowControl(QSerialPort::NoFlowControl);
+        // Several simulated devices may be opened with numbered names, e.g. "Simulator 2"
+        if (portName.startsWith(DeviceSimulator::portName))
+        {
+            simulator->setBaudRate(baudRate);
+            device = simulator;
+        }
+        else
+        {
+            qSerialPort->setBaudRate(baudRate);
+            qSerialPort->setDataBits(QSerialPort::Data8);
+            qSerialPort->setParity(QSerialPort::NoParity);
+            qSerialPort->setStopBits(QSerialPort::OneStop);
+            qSerialPort->setFlowControl(QSerialPort::NoFlowControl);
+            device = qSerialPort;
+        }
 
-        result = qSerialPort->open(QIODevice::ReadWrite);
+        result = device->open(QIODevice::ReadWrite);
         if (result)
         {
-            qInfo() << "Port opened:" << qSerialPort->portName() << qSerialPort->baudRate();
+            qInfo() << "Port opened:" << qSerialPort->portName() << baudRate;
             emit opened();
         }
         else
         {
-            qCritical() << "Failed to open port" << qSerialPort->portName() << ":" << qSerialPort->errorString();
+            qCritical() << "Failed to open port" << qSerialPort->portName() << ":" << device->errorString();
+            emit openFailed();
         }
     }
     else
@@ -72,12 +109,45 @@ bool SerialPort::open(const QString &portName, int baudRate)
     return result;
 }
 
+bool SerialPort::setBaudRate(int baudRate)
+{
+    bool result = true;
+    if (device == simulator)
+    {
+        simulator->setBaudRate(baudRate);
+    }
+    else
+    {
+        // Adapter may not support the rate
+        result = qSerialPort->setBaudRate(baudRate);
+    }
+
+    if (result == true)
+    {
+        qDebug() << "Port" << qSerialPort->portName() << "baud rate:" << baudRate;
+    }
+    else
+    {
+        qWarning() << "Port" << qSerialPort->portName() << "doesn't support" << baudRate << "baud:" << device->errorString();
+    }
+
+    return result;
+}
+
+void SerialPort::setSimulatorConfig(const DeviceSimulator::Config &config)
+{
+    // Packet format is taken by the simulator for the next packets, line conditions right away
+    simulator->setConfig(config);
+}
+
 void SerialPort::close()
 {
-    if (qSerialPort->isOpen() == true)
+    if (device->isOpen() == true)
     {
-        qSerialPort->close();
+        failRequests();
+        device->close();
         qInfo() << "Port closed:" << qSerialPort->portName();
+        notifyCompleted();
         emit closed();
     }
     else
@@ -86,25 +156,73 @@ void SerialPort::close()
     }
 }
 
-bool SerialPort::write(const QByteArray &data)
+bool SerialPort::write(const QByteArray &data, Priority priority, WriteCallback callback,
+                       std::chrono::milliseconds timeout)
 {
-    bool result = false;
+    if (device->isOpen() == false)
+    {
+        qWarning() << "Port" << qSerialPort->portName() << "write failed: port isn't opened";
+        return false;
+    }
 
     qDebug() << "Write:" << data;
 
-    const qint64 written = qSerialPort->write(data);
-    if (written == data.size())
-    {
-        bytesToWrite += written;
-        writeTimer.start(writeTimeout);
-        result = true;
-    }
-    else
-    {
-        qWarning() << "Port" << qSerialPort->portName() << "write failed:" << qSerialPort->errorString();
-    }
+    const qint64 nowNs = txClock.nsecsElapsed();
+    const auto requestTimeout = (timeout > std::chrono::milliseconds::zero()) ? timeout : writeTimeout;
 
-    return result;
+    TxRequest request;
+    request.data = data;
+    request.callback = std::move(callback);
+    request.queuedNs = nowNs;
+    request.deadlineNs = nowNs + std::chrono::duration_cast<std::chrono::nanoseconds>(requestTimeout).count();
+    request.pendingBytes = data.size();
+    txQueues[static_cast<int>(priority)].append(std::move(request));
+
+    tx.requests++;
+    tx.queuedBytes += data.size();
+    tx.queuedBytesMax = std::max(tx.queuedBytesMax, tx.queuedBytes);
+
+    // Idle line is written right away, otherwise the request waits for the previous write
+    const qint64 failures = tx.failures;
+    flush();
+    updateWriteTimer();
+    notifyCompleted();
+
+    return (tx.failures == failures);
+}
+
+SerialPort::TxStats SerialPort::txStats() const
+{
+    return tx;
+}
+
+qint64 SerialPort::readAllocations() const
+{
+    return readAllocationCount;
+}
+
+void SerialPort::resetReadAllocations()
+{
+    readAllocationCount = 0;
+}
+
+void SerialPort::resetTxStats()
+{
+    // Bytes waiting in the queue belong to the current state, not to the statistics
+    const qint64 queuedBytes = tx.queuedBytes;
+    tx = TxStats();
+    tx.queuedBytes = queuedBytes;
+    tx.queuedBytesMax = queuedBytes;
+}
+
+QString SerialPort::txStatsText() const
+{
+    const double latencyAvgMs = (tx.completed > 0) ? static_cast<double>(tx.latencyTotalUs) / tx.completed / 1000 : 0;
+    return QString::number(tx.requests) + " request(s) in " + QString::number(tx.writes) + " write(s), " +
+           QString::number(tx.writtenBytes) + " bytes, queued max " + QString::number(tx.queuedBytesMax) +
+           " bytes, latency avg " + QString::number(latencyAvgMs, 'f', 3) + " ms max " +
+           QString::number(tx.latencyMaxUs / 1000.0, 'f', 3) + " ms, " + QString::number(tx.timeouts) +
+           " timeout(s), " + QString::number(tx.failures) + " failure(s)";
 }
 
 void SerialPort::onPortError(QSerialPort::SerialPortError error)
@@ -121,20 +239,246 @@ void SerialPort::onPortError(QSerialPort::SerialPortError error)
 
 void SerialPort::onPortReadData()
 {
-    const QByteArray data = qSerialPort->readAll();
-    emit read(data);
+    // Read buffer is reused, receivers get it for the time of the call
+    const qint64 available = device->bytesAvailable();
+    if (readBuffer.isDetached() == false || readBuffer.capacity() < available)
+    {
+        // Buffer kept by a receiver or too small is allocated again
+        readAllocationCount++;
+    }
+    readBuffer.resize(available);
+    const qint64 size = device->read(readBuffer.data(), available);
+    readBuffer.resize(std::max<qint64>(size, 0));
+    emit read(readBuffer);
+
+    if (readBuffer.isEmpty() == false)
+    {
+        emit activity();
+    }
 }
 
 void SerialPort::onPortWritten(qint64 bytes)
 {
-    bytesToWrite -= bytes;
-    if (bytesToWrite == 0)
+    txInFlightBytes = std::max<qint64>(txInFlightBytes - bytes, 0);
+    tx.queuedBytes = std::max<qint64>(tx.queuedBytes - bytes, 0);
+    tx.writtenBytes += bytes;
+
+    // Written bytes complete the requests in the order they were written
+    while (bytes > 0 && txInFlight.isEmpty() == false)
     {
-        writeTimer.stop();
+        TxRequest &request = txInFlight.first();
+        const qint64 count = std::min(bytes, request.pendingBytes);
+        request.pendingBytes -= count;
+        bytes -= count;
+        if (request.pendingBytes > 0)
+        {
+            break;
+        }
+
+        complete(request, true);
+        txInFlight.removeFirst();
     }
+
+    flush();
+    updateWriteTimer();
+    notifyCompleted();
 }
 
 void SerialPort::onWriteTimeout()
 {
-    qWarning() << "Port" << qSerialPort->portName() << "write timeout:" << qSerialPort->errorString();
+    const qint64 nowNs = txClock.nsecsElapsed();
+    qint64 timeouts = 0;
+
+    // Queued requests are dropped, written ones are only reported, their bytes are still expected from the device
+    for (QList<TxRequest> &queue : txQueues)
+    {
+        for (qsizetype index = 0; index < queue.size();)
+        {
+            if (queue[index].deadlineNs > nowNs)
+            {
+                index++;
+                continue;
+            }
+
+            tx.queuedBytes -= queue[index].data.size();
+            complete(queue[index], false);
+            queue.removeAt(index);
+            timeouts++;
+        }
+    }
+
+    for (TxRequest &request : txInFlight)
+    {
+        if (request.isTimedOut == false && request.deadlineNs <= nowNs)
+        {
+            complete(request, false);
+            request.isTimedOut = true;
+            timeouts++;
+        }
+    }
+
+    if (timeouts > 0)
+    {
+        tx.timeouts += timeouts;
+        qWarning() << "Port" << qSerialPort->portName() << "write timeout," << timeouts << "request(s):"
+                   << device->errorString();
+    }
+
+    updateWriteTimer();
+    notifyCompleted();
+}
+
+void SerialPort::flush()
+{
+    if (txInFlightBytes > 0 || device->isOpen() == false)
+    {
+        return;
+    }
+
+    // Adjacent requests are joined into one device write, higher priority first
+    const qsizetype firstInFlight = txInFlight.size();
+    qsizetype size = 0;
+    for (QList<TxRequest> &queue : txQueues)
+    {
+        while (queue.isEmpty() == false &&
+               (size == 0 || size + queue.first().data.size() <= coalesceSizeMax))
+        {
+            size += queue.first().data.size();
+            txInFlight.append(queue.takeFirst());
+        }
+    }
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    qint64 written = 0;
+    if (txInFlight.size() - firstInFlight == 1)
+    {
+        // Single request is written as is
+        written = device->write(txInFlight.last().data);
+    }
+    else
+    {
+        // Buffer is reused, device copies written data
+        txBuffer.resize(0);
+        for (qsizetype index = firstInFlight; index < txInFlight.size(); index++)
+        {
+            txBuffer.append(txInFlight[index].data);
+        }
+        written = device->write(txBuffer);
+    }
+    tx.writes++;
+
+    if (written == size)
+    {
+        txInFlightBytes += written;
+        return;
+    }
+
+    qWarning() << "Port" << qSerialPort->portName() << "write failed:" << device->errorString();
+    tx.failures += txInFlight.size() - firstInFlight;
+    tx.queuedBytes -= size;
+    while (txInFlight.size() > firstInFlight)
+    {
+        complete(txInFlight.last(), false);
+        txInFlight.removeLast();
+    }
+}
+
+void SerialPort::complete(TxRequest &request, bool result)
+{
+    if (request.isTimedOut == true)
+    {
+        // Already reported on timeout
+        return;
+    }
+
+    const auto latency = std::chrono::microseconds((txClock.nsecsElapsed() - request.queuedNs) / nsPerUs);
+    if (result == true)
+    {
+        tx.completed++;
+        tx.latencyTotalUs += latency.count();
+        tx.latencyMaxUs = std::max<qint64>(tx.latencyMaxUs, latency.count());
+    }
+
+    if (request.callback)
+    {
+        txCompleted.append({std::move(request.callback), result, latency});
+        request.callback = nullptr;
+    }
+}
+
+void SerialPort::notifyCompleted()
+{
+    if (txCompleted.isEmpty())
+    {
+        return;
+    }
+
+    const QList<TxCompletion> completions = std::move(txCompleted);
+    txCompleted.clear();
+    for (const TxCompletion &completion : completions)
+    {
+        completion.callback(completion.result, completion.latency);
+    }
+}
+
+void SerialPort::failRequests()
+{
+    // Requests can't be written any more, their owners are notified
+    for (QList<TxRequest> &queue : txQueues)
+    {
+        for (TxRequest &request : queue)
+        {
+            complete(request, false);
+        }
+        tx.failures += queue.size();
+        queue.clear();
+    }
+
+    for (TxRequest &request : txInFlight)
+    {
+        complete(request, false);
+    }
+    tx.failures += txInFlight.size();
+    txInFlight.clear();
+
+    txInFlightBytes = 0;
+    tx.queuedBytes = 0;
+    writeTimer.stop();
+}
+
+void SerialPort::updateWriteTimer()
+{
+    // Timer is set to the nearest deadline of the requests not reported yet
+    qint64 deadlineNs = -1;
+    auto checkRequest = [&deadlineNs](const TxRequest &request) {
+        if (request.isTimedOut == false && (deadlineNs < 0 || request.deadlineNs < deadlineNs))
+        {
+            deadlineNs = request.deadlineNs;
+        }
+    };
+
+    for (const QList<TxRequest> &queue : txQueues)
+    {
+        for (const TxRequest &request : queue)
+        {
+            checkRequest(request);
+        }
+    }
+    for (const TxRequest &request : txInFlight)
+    {
+        checkRequest(request);
+    }
+
+    if (deadlineNs < 0)
+    {
+        writeTimer.stop();
+        return;
+    }
+
+    const qint64 remainingNs = std::max<qint64>(deadlineNs - txClock.nsecsElapsed(), 0);
+    writeTimer.start(std::chrono::ceil<std::chrono::milliseconds>(std::chrono::nanoseconds(remainingNs)));
 }
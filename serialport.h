@@ -1,28 +1,92 @@
 #ifndef SERIALPORT_H
 #define SERIALPORT_H
 
+#include <chrono>
+#include <functional>
+
 #include <QByteArray>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QList>
 #include <QObject>
 #include <QSerialPort>
 #include <QString>
 #include <QTimer>
 
+#include "devicesimulator.h"
+
+/**
+ * @brief Serial port of the device, DeviceSimulator::portName selects simulated device instead of the real port
+ *
+ * Written data is queued: a request is written to the device right away if the line is idle, otherwise it waits
+ * until the previous write completes and adjacent requests are joined into one device write.
+ */
 class SerialPort : public QObject
 {
     Q_OBJECT
 public:
+    /**
+     * @brief Transmit priority, commands go before keep alives waiting in the queue
+     */
+    enum class Priority
+    {
+        Command,
+        KeepAlive,
+
+        Count
+    };
+
+    /**
+     * @brief Called when the request is written (result is true) or dropped on timeout or error
+     * Latency is counted from the write call
+     */
+    using WriteCallback = std::function<void(bool result, std::chrono::microseconds latency)>;
+
+    /**
+     * @brief Transmit queue counters
+     */
+    struct TxStats
+    {
+        qint64 requests = 0;
+        // Device writes, fewer than requests if they are joined
+        qint64 writes = 0;
+        qint64 writtenBytes = 0;
+        // Bytes accepted and not written yet, current and the highest value
+        qint64 queuedBytes = 0;
+        qint64 queuedBytesMax = 0;
+        qint64 completed = 0;
+        qint64 timeouts = 0;
+        qint64 failures = 0;
+        qint64 latencyTotalUs = 0;
+        qint64 latencyMaxUs = 0;
+    };
+
     explicit SerialPort(QObject *parent = nullptr);
     ~SerialPort();
 
     bool isOpened();
+    int baudRate();
     bool open(const QString &portName, int baudRate);
+    bool setBaudRate(int baudRate);
+    void setSimulatorConfig(const DeviceSimulator::Config &config);
     void close();
-    bool write(const QByteArray &data);
+    bool write(const QByteArray &data, Priority priority = Priority::Command, WriteCallback callback = nullptr,
+               std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
+
+    TxStats txStats() const;
+    void resetTxStats();
+    QString txStatsText() const;
+    qint64 readAllocations() const;
+    void resetReadAllocations();
 
 signals:
     void opened();
+    void openFailed();
     void closed();
+    // Read buffer is reused, so it's for direct receivers in the port thread only
     void read(const QByteArray &data);
+    // Data is received, for receivers in other threads
+    void activity();
 
 private slots:
     void onPortError(QSerialPort::SerialPortError error);
@@ -31,9 +95,52 @@ private slots:
     void onWriteTimeout();
 
 private:
+    /**
+     * @brief Write request waiting in the queue or written to the device
+     */
+    struct TxRequest
+    {
+        QByteArray data;
+        WriteCallback callback;
+        qint64 queuedNs = 0;
+        qint64 deadlineNs = 0;
+        // Bytes not reported as written yet
+        qint64 pendingBytes = 0;
+        bool isTimedOut = false;
+    };
+
+    /**
+     * @brief Completed request to report, callbacks are called after the queue is updated, so they can write again
+     */
+    struct TxCompletion
+    {
+        WriteCallback callback;
+        bool result;
+        std::chrono::microseconds latency;
+    };
+
+    void flush();
+    void complete(TxRequest &request, bool result);
+    void notifyCompleted();
+    void failRequests();
+    void updateWriteTimer();
+
     QSerialPort *qSerialPort = nullptr;
+    DeviceSimulator *simulator = nullptr;
+    // Active backend: real port or simulator
+    QIODevice *device = nullptr;
     QTimer writeTimer;
-    qint64 bytesToWrite = 0;
+    QByteArray readBuffer;
+    qint64 readAllocationCount = 0;
+
+    // Queue per priority and requests written to the device in order
+    QElapsedTimer txClock;
+    QList<TxRequest> txQueues[static_cast<int>(Priority::Count)];
+    QList<TxRequest> txInFlight;
+    qint64 txInFlightBytes = 0;
+    QByteArray txBuffer;
+    QList<TxCompletion> txCompleted;
+    TxStats tx;
 };
 
 #endif // SERIALPORT_H
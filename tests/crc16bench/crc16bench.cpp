@@ -0,0 +1,148 @@
+#include <algorithm>
+
+#include <QByteArray>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include "crc16.h"
+
+namespace
+{
+// Random buffers of every length up to a few frame headers, all tail lengths of slice-by-4 are covered
+constexpr int checkedLengthMax = 600;
+constexpr int buffersPerLength = 16;
+// Benchmark runs over frames of the largest download packet
+constexpr int benchFrameSize = 64 * 1024;
+constexpr qint64 benchBytes = 256LL * 1024 * 1024;
+constexpr quint32 randomSeed = 0x5EED;
+
+/**
+ * @brief Reference bitwise CRC16-MODBUS, the implementation replaced by the table kernel
+ */
+uint16_t referenceCrc16(uint16_t crc, const char *data, qsizetype size)
+{
+    for (qsizetype pos = 0; pos < size; pos++)
+    {
+        crc ^= static_cast<uint8_t>(data[pos]);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            if (crc & 0x0001)
+                crc = (crc >> 1) ^ 0xA001;
+            else
+                crc >>= 1;
+        }
+    }
+
+    return crc;
+}
+
+QByteArray randomBuffer(QRandomGenerator &random, qsizetype size)
+{
+    QByteArray data(size, '\0');
+    for (qsizetype pos = 0; pos < size; pos++)
+    {
+        data[pos] = static_cast<char>(random.bounded(256));
+    }
+    return data;
+}
+
+/**
+ * @brief Compare whole buffer, split incremental and single byte updates against reference
+ */
+bool checkBuffer(QRandomGenerator &random, const QByteArray &data)
+{
+    const uint16_t expected = referenceCrc16(Crc16::initValue, data.constData(), data.size());
+
+    if (Crc16::calculate(data) != expected)
+    {
+        qCritical() << "Slice-by-4 CRC mismatch, length" << data.size();
+        return false;
+    }
+
+    // Frame bytes are folded into CRC in arbitrary chunks as they arrive from the port
+    const qsizetype split = random.bounded(static_cast<int>(data.size()) + 1);
+    uint16_t crc = Crc16::update(Crc16::initValue, data.constData(), split);
+    crc = Crc16::update(crc, data.constData() + split, data.size() - split);
+    if (crc != expected)
+    {
+        qCritical() << "Incremental CRC mismatch, length" << data.size() << "split" << split;
+        return false;
+    }
+
+    crc = Crc16::initValue;
+    for (char byte : data)
+    {
+        crc = Crc16::update(crc, static_cast<uint8_t>(byte));
+    }
+    if (crc != expected)
+    {
+        qCritical() << "Single byte CRC mismatch, length" << data.size();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Throughput in MB/s of the CRC function over one frame repeated up to benchBytes
+ */
+template <typename Function>
+double measure(const QByteArray &frame, Function function)
+{
+    uint16_t crc = Crc16::initValue;
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 bytes = 0; bytes < benchBytes; bytes += frame.size())
+    {
+        crc = function(crc, frame.constData(), frame.size());
+    }
+    const qint64 ns = std::max(timer.nsecsElapsed(), qint64(1));
+
+    // Result is used, so the loop isn't optimised out
+    qDebug() << "CRC" << Qt::hex << crc;
+    return static_cast<double>(benchBytes) * 1000 / ns;
+}
+}
+
+int main()
+{
+    QRandomGenerator random(randomSeed);
+
+    int checkedBuffers = 0;
+    for (int length = 0; length <= checkedLengthMax; length++)
+    {
+        for (int idx = 0; idx < buffersPerLength; idx++)
+        {
+            bool result = checkBuffer(random, randomBuffer(random, length));
+            if (result == false)
+            {
+                return 1;
+            }
+            checkedBuffers++;
+        }
+    }
+    qInfo() << "Slice-by-4 CRC matches reference on" << checkedBuffers << "random buffers";
+
+    const QByteArray frame = randomBuffer(random, benchFrameSize);
+    const double referenceRate = measure(frame, referenceCrc16);
+    const double tableRate = measure(frame, [](uint16_t crc, const char *data, qsizetype size)
+    {
+        // Single table step per byte, as used for bytes folded in one at a time
+        for (qsizetype pos = 0; pos < size; pos++)
+        {
+            crc = Crc16::update(crc, static_cast<uint8_t>(data[pos]));
+        }
+        return crc;
+    });
+    const double sliceRate = measure(frame, [](uint16_t crc, const char *data, qsizetype size)
+    {
+        return Crc16::update(crc, data, size);
+    });
+    qInfo().nospace() << "Bitwise: " << qRound(referenceRate) << " MB/s";
+    qInfo().nospace() << "Byte table: " << qRound(tableRate) << " MB/s, speedup " << tableRate / referenceRate;
+    qInfo().nospace() << "Slice-by-4: " << qRound(sliceRate) << " MB/s, speedup " << sliceRate / referenceRate;
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+QT       = core
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../crc16.cpp \
+    crc16bench.cpp
+
+HEADERS += \
+    ../../crc16.h
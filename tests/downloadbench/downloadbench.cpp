@@ -0,0 +1,154 @@
+#include <algorithm>
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+
+#include "communicator.h"
+#include "devicesimulator.h"
+#include "packets.h"
+#include "serialport.h"
+
+namespace
+{
+constexpr int sensorType = 0;
+// Pipeline window 1 is the sequential download, one request per round trip
+constexpr int pipelineWindows[] = {1, 4, 16};
+constexpr int simulatorLatencyMs = 2;
+
+/**
+ * @brief Downloaded data type and size, fewer large packets keep the run short
+ */
+struct Run
+{
+    const char *name;
+    DataType dataType;
+    int psdPoints;
+    int packetCount;
+};
+
+constexpr Run runs[] = {
+    {"Statistic", DataType::Statistic, 0, 200},
+    {"PSD 128 points", DataType::Psd, 128, 100},
+    {"PSD 4096 points", DataType::Psd, 4096, 20},
+};
+
+/**
+ * @brief Download all packets of the run from the simulator, returns downloaded packet count or -1 on failure
+ */
+int download(Communicator &communicator, const Run &run, int window, qint64 &downloadedBytes)
+{
+    const int packetCount = run.packetCount;
+    bool result = communicator.setDownloadRecent(0, packetCount - 1) &&
+                  communicator.setDownloadType(sensorType, static_cast<int>(run.dataType));
+    int downloadSize = 0;
+    result = result && communicator.getDownloadSize(downloadSize);
+    if (result == false)
+    {
+        qCritical() << "Download request failed";
+        return -1;
+    }
+
+    int downloadedPackets = 0;
+    downloadedBytes = 0;
+    if (window > 1)
+    {
+        result = communicator.getDownloadDataPipelined(0, packetCount, window, [&](int, QByteArray data)
+        {
+            downloadedPackets++;
+            downloadedBytes += data.size();
+            communicator.framePool().release(data);
+            return true;
+        });
+    }
+    else
+    {
+        for (int downloadId = 0; downloadId < packetCount && result == true; downloadId++)
+        {
+            int packetId = 0;
+            QByteArray data;
+            result = communicator.setDownloadId(downloadId) && communicator.getDownloadData(packetId, data);
+            if (result == true && packetId == downloadId)
+            {
+                downloadedPackets++;
+                downloadedBytes += data.size();
+            }
+        }
+    }
+
+    if (result == false || downloadedBytes != downloadSize)
+    {
+        qCritical() << "Downloaded" << downloadedBytes << "of" << downloadSize << "bytes";
+        return -1;
+    }
+
+    return downloadedPackets;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    // Per packet debug output would be measured as well
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    // Line conditions can be changed with DEVICE_SIMULATOR, packet format is set by every run
+    DeviceSimulator::Config config;
+    config.latencyMs = simulatorLatencyMs;
+    if (qEnvironmentVariableIsEmpty("DEVICE_SIMULATOR") == false)
+    {
+        config = DeviceSimulator::Config::fromString(qEnvironmentVariable("DEVICE_SIMULATOR"));
+    }
+
+    SerialPort serialPort;
+    serialPort.setSimulatorConfig(config);
+    Communicator communicator(&serialPort);
+
+    // Link is set up the same way as the application does, so the device is used at the highest rate
+    bool result = serialPort.open(DeviceSimulator::portName, 115200) &&
+                  communicator.setupLink(Communicator::linkBaudRateMax);
+    if (result == false)
+    {
+        qCritical() << "Simulator link setup failed";
+        return 1;
+    }
+
+    qInfo() << "Simulator:" << config.toString() << "," << serialPort.baudRate() << "baud";
+    for (const Run &run : runs)
+    {
+        if (run.psdPoints > 0)
+        {
+            config.psdPoints = run.psdPoints;
+            serialPort.setSimulatorConfig(config);
+        }
+
+        qInfo().nospace() << run.name << ", " << run.packetCount << " packets:";
+        for (int window : pipelineWindows)
+        {
+            communicator.resetSessionCounters();
+
+            QElapsedTimer timer;
+            timer.start();
+            qint64 downloadedBytes = 0;
+            const int downloadedPackets = download(communicator, run, window, downloadedBytes);
+            const qint64 ms = std::max<qint64>(timer.elapsed(), 1);
+            if (downloadedPackets < 0)
+            {
+                communicator.closeLink();
+                return 1;
+            }
+
+            const double bytesPerSec = static_cast<double>(downloadedBytes) * 1000 / ms;
+            qInfo().nospace() << "  window " << window << ": "
+                              << qRound(static_cast<double>(downloadedPackets) * 1000 / ms) << " packets/s, "
+                              << qRound(bytesPerSec / 1024) << " kB/s, "
+                              << qRound(bytesPerSec * 100 / communicator.lineRate()) << "% of line rate";
+        }
+    }
+
+    communicator.closeLink();
+    return 0;
+}
@@ -0,0 +1,24 @@
+QT       = core serialport
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../bufferpool.cpp \
+    ../../commandstats.cpp \
+    ../../communicator.cpp \
+    ../../crc16.cpp \
+    ../../devicesimulator.cpp \
+    ../../serialport.cpp \
+    downloadbench.cpp
+
+HEADERS += \
+    ../../bufferpool.h \
+    ../../commandstats.h \
+    ../../communicator.h \
+    ../../crc16.h \
+    ../../devicesimulator.h \
+    ../../packets.h \
+    ../../serialport.h
@@ -0,0 +1,278 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QRandomGenerator>
+#include <QTimeZone>
+
+#include "packets.h"
+#include "parser.h"
+
+namespace
+{
+constexpr int psdPointsSmall = 512;
+constexpr int psdPointsLarge = 4096;
+constexpr int packetCount = 200;
+constexpr quint32 randomSeed = 0x5EED;
+
+// Heap allocations made by the whole program, counted by the replaced heap functions
+qint64 allocationCount = 0;
+
+QByteArray makePsdPacket(QRandomGenerator &random, int points)
+{
+    PacketHeader header = {};
+    header.startEpochTime = 1700000000;
+    header.durationMs = 1000;
+    header.sampleTimeMs = 10;
+    header.dataType = static_cast<uint8_t>(DataType::Psd);
+
+    PsdHeader psdHeader = {};
+    psdHeader.coreFrequency = 12.5f;
+    psdHeader.coreAmplitude = 1.0f;
+    psdHeader.deltaFrequency = 0.5f;
+    psdHeader.points = static_cast<uint32_t>(points);
+
+    QByteArray packet;
+    packet.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    packet.append(reinterpret_cast<const char*>(&psdHeader), sizeof(psdHeader));
+    for (int idx = 0; idx < points; idx++)
+    {
+        const PsdPoint amplitude = static_cast<float>(random.generateDouble());
+        packet.append(reinterpret_cast<const char*>(&amplitude), sizeof(amplitude));
+    }
+    return packet;
+}
+
+/**
+ * @brief PSD packet with NaN and infinite amplitudes and core values, as sent by a faulty sensor
+ */
+QByteArray makeNonFinitePsdPacket(QRandomGenerator &random)
+{
+    QByteArray packet = makePsdPacket(random, 4);
+    const PsdPoint values[] = {NAN, INFINITY, -INFINITY, 0.5f};
+    char *psdHeader = packet.data() + sizeof(PacketHeader);
+    memcpy(psdHeader + offsetof(PsdHeader, coreFrequency), &values[0], sizeof(float));
+    memcpy(psdHeader + offsetof(PsdHeader, coreAmplitude), &values[1], sizeof(float));
+    memcpy(psdHeader + sizeof(PsdHeader), values, sizeof(values));
+    return packet;
+}
+
+/**
+ * @brief Reference PSD conversion building QJsonDocument, the implementation replaced by the streaming writer
+ */
+bool referenceToJson(const QByteArray &rawData, QByteArray &jsonData)
+{
+    PacketHeader packetHeader;
+    memcpy(&packetHeader, rawData.constData(), sizeof(packetHeader));
+    PsdHeader psdHeader;
+    memcpy(&psdHeader, rawData.constData() + sizeof(PacketHeader), sizeof(PsdHeader));
+    const char *psdPoints = rawData.constData() + sizeof(PacketHeader) + sizeof(PsdHeader);
+
+    QJsonObject packetHeaderJson;
+    auto startDateTime = QDateTime::fromSecsSinceEpoch(packetHeader.startEpochTime, QTimeZone::utc());
+    packetHeaderJson["start time"] = startDateTime.toString("yyyy-MM-dd hh:mm:ss");
+    packetHeaderJson["duration ms"] = static_cast<int>(packetHeader.durationMs);
+    packetHeaderJson["sample time ms"] = static_cast<int>(packetHeader.sampleTimeMs);
+
+    QJsonObject psdHeaderJson;
+    psdHeaderJson["core freq"] = psdHeader.coreFrequency;
+    psdHeaderJson["core ampl"] = psdHeader.coreAmplitude;
+    psdHeaderJson["delta freq"] = psdHeader.deltaFrequency;
+    psdHeaderJson["points"] = static_cast<int>(psdHeader.points);
+
+    QJsonArray psdPointsJson;
+    for (size_t idx = 0; idx < psdHeader.points; idx++)
+    {
+        PsdPoint amplitude;
+        memcpy(&amplitude, psdPoints + idx * sizeof(PsdPoint), sizeof(PsdPoint));
+
+        QJsonObject pointJson;
+        pointJson["ampl"] = amplitude;
+        pointJson["freq"] = static_cast<float>(idx) * psdHeader.deltaFrequency;
+        psdPointsJson.append(pointJson);
+    }
+
+    QJsonObject json;
+    json["packet header"] = packetHeaderJson;
+    json["psd header"] = psdHeaderJson;
+    json["psd points"] = psdPointsJson;
+    jsonData = QJsonDocument(json).toJson(QJsonDocument::Indented);
+    return true;
+}
+
+struct Measurement
+{
+    double usPerPacket = 0;
+    double allocationsPerPacket = 0;
+};
+
+/**
+ * @brief Convert all packets with the function, output buffer is passed to the function as is
+ */
+template <typename Function>
+Measurement measure(const QList<QByteArray> &packets, Function function)
+{
+    QByteArray jsonData;
+    const qint64 startAllocations = allocationCount;
+    QElapsedTimer timer;
+    timer.start();
+    for (const QByteArray &packet : packets)
+    {
+        function(packet, jsonData);
+    }
+    const qint64 ns = timer.nsecsElapsed();
+
+    Measurement measurement;
+    measurement.usPerPacket = static_cast<double>(ns) / 1000 / packets.size();
+    measurement.allocationsPerPacket = static_cast<double>(allocationCount - startAllocations) / packets.size();
+    return measurement;
+}
+
+void report(const char *name, const Measurement &measurement)
+{
+    qInfo().nospace() << "  " << name << ": " << measurement.usPerPacket << " us/packet, "
+                      << measurement.allocationsPerPacket << " allocations/packet";
+}
+
+/**
+ * @brief Streaming output has to be the same document as the reference one
+ */
+bool checkOutput(const QByteArray &packet)
+{
+    QByteArray referenceJson;
+    referenceToJson(packet, referenceJson);
+
+    QByteArray indentedJson;
+    QByteArray compactJson;
+    bool result = Parser::toJson(packet, indentedJson, Parser::JsonFormat::Indented) &&
+                  Parser::toJson(packet, compactJson, Parser::JsonFormat::Compact);
+    if (result == false)
+    {
+        qCritical() << "Packet conversion failed";
+        return false;
+    }
+
+    const QJsonDocument reference = QJsonDocument::fromJson(referenceJson);
+    if (QJsonDocument::fromJson(indentedJson) != reference || QJsonDocument::fromJson(compactJson) != reference)
+    {
+        qCritical() << "Streaming JSON differs from QJsonDocument output";
+        return false;
+    }
+
+    return true;
+}
+
+bool runBenchmark(QRandomGenerator &random, int points)
+{
+    QList<QByteArray> packets;
+    for (int idx = 0; idx < packetCount; idx++)
+    {
+        packets.append(makePsdPacket(random, points));
+    }
+
+    if (checkOutput(packets.first()) == false || checkOutput(makeNonFinitePsdPacket(random)) == false)
+    {
+        return false;
+    }
+
+    qInfo() << "PSD packet of" << points << "points:";
+    report("QJsonDocument", measure(packets, [](const QByteArray &packet, QByteArray &jsonData)
+    {
+        referenceToJson(packet, jsonData);
+    }));
+    report("streaming, new buffer", measure(packets, [](const QByteArray &packet, QByteArray &jsonData)
+    {
+        jsonData = QByteArray();
+        Parser::toJson(packet, jsonData);
+    }));
+    report("streaming, reused buffer", measure(packets, [](const QByteArray &packet, QByteArray &jsonData)
+    {
+        // Size is reset, capacity of the previous packet is kept
+        jsonData.resize(0);
+        Parser::toJson(packet, jsonData);
+    }));
+    report("streaming compact, reused buffer", measure(packets, [](const QByteArray &packet, QByteArray &jsonData)
+    {
+        jsonData.resize(0);
+        Parser::toJson(packet, jsonData, Parser::JsonFormat::Compact);
+    }));
+
+    return true;
+}
+}
+
+#if defined(__GLIBC__)
+// Heap functions of glibc are replaced, so buffers of Qt containers are counted as well as operator new
+extern "C"
+{
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+
+void *malloc(std::size_t size)
+{
+    allocationCount++;
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size)
+{
+    allocationCount++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, std::size_t size)
+{
+    allocationCount++;
+    return __libc_realloc(pointer, size);
+}
+}
+#else
+// Only operator new is counted, growth of Qt container buffers isn't visible
+void *operator new(std::size_t size)
+{
+    allocationCount++;
+    void *pointer = std::malloc(size > 0 ? size : 1);
+    if (pointer == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+int main()
+{
+    QRandomGenerator random(randomSeed);
+
+    for (int points : {psdPointsSmall, psdPointsLarge})
+    {
+        bool result = runBenchmark(random, points);
+        if (result == false)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+QT       = core
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../parser.cpp \
+    ../../psdanalysis.cpp \
+    ../../rawseries.cpp \
+    parserbench.cpp
+
+HEADERS += \
+    ../../packets.h \
+    ../../parser.h \
+    ../../psdanalysis.h \
+    ../../rawseries.h
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <QByteArray>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include "packets.h"
+#include "psdanalysis.h"
+
+namespace
+{
+// Every vector tail length is covered, points start at odd offset as they do in the packet
+constexpr int checkedPointsMax = 100;
+constexpr int buffersPerLength = 16;
+constexpr int benchPoints = 4096;
+constexpr qint64 benchTotalPoints = 100LL * 1000 * 1000;
+constexpr quint32 randomSeed = 0x5EED;
+// Vector kernels sum in float lanes and approximate logarithm, so results match the reference up to rounding
+constexpr double sumTolerance = 1e-5;
+constexpr float decibelsTolerance = 1e-3f;
+
+/**
+ * @brief Points buffer shifted by one byte from the allocation start, every 8th amplitude is zero
+ */
+QByteArray randomPoints(QRandomGenerator &random, int count)
+{
+    QByteArray data(1 + count * static_cast<int>(sizeof(PsdPoint)), '\0');
+    for (int idx = 0; idx < count; idx++)
+    {
+        const PsdPoint amplitude = (idx % 8 == 7) ? 0.0f : static_cast<float>(random.generateDouble() * 10);
+        memcpy(data.data() + 1 + idx * sizeof(PsdPoint), &amplitude, sizeof(amplitude));
+    }
+    return data;
+}
+
+float pointAt(const char *points, qsizetype idx)
+{
+    PsdPoint amplitude;
+    memcpy(&amplitude, points + idx * sizeof(PsdPoint), sizeof(PsdPoint));
+    return amplitude;
+}
+
+// Reference kernels, plain loops over the standard library functions
+
+double referenceSum(const char *points, qsizetype count)
+{
+    double sum = 0;
+    for (qsizetype idx = 0; idx < count; idx++)
+    {
+        sum += pointAt(points, idx);
+    }
+    return sum;
+}
+
+qsizetype referencePeak(const char *points, qsizetype count)
+{
+    qsizetype peakIdx = 0;
+    for (qsizetype idx = 1; idx < count; idx++)
+    {
+        if (pointAt(points, idx) > pointAt(points, peakIdx))
+        {
+            peakIdx = idx;
+        }
+    }
+    return peakIdx;
+}
+
+void referenceDecibels(const char *points, qsizetype count, float *decibels)
+{
+    for (qsizetype idx = 0; idx < count; idx++)
+    {
+        decibels[idx] = 10 * std::log10(std::max(pointAt(points, idx), FLT_MIN));
+    }
+}
+
+bool checkPoints(const QByteArray &data, int count)
+{
+    const char *points = data.constData() + 1;
+
+    const double expectedSum = referenceSum(points, count);
+    const double sum = PsdAnalysis::sum(points, count);
+    if (std::abs(sum - expectedSum) > sumTolerance * std::max(expectedSum, 1.0))
+    {
+        qCritical() << "Sum mismatch," << count << "points:" << sum << "!=" << expectedSum;
+        return false;
+    }
+
+    const qsizetype expectedPeak = referencePeak(points, count);
+    const qsizetype peak = PsdAnalysis::peak(points, count);
+    if (peak != expectedPeak)
+    {
+        qCritical() << "Peak mismatch," << count << "points:" << peak << "!=" << expectedPeak;
+        return false;
+    }
+
+    std::vector<float> expectedDecibels(count);
+    std::vector<float> decibels(count);
+    referenceDecibels(points, count, expectedDecibels.data());
+    PsdAnalysis::toDecibels(points, count, decibels.data());
+    for (int idx = 0; idx < count; idx++)
+    {
+        if (std::abs(decibels[idx] - expectedDecibels[idx]) > decibelsTolerance)
+        {
+            qCritical() << "dB mismatch," << count << "points, point" << idx << ":" << decibels[idx] << "!="
+                        << expectedDecibels[idx];
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Throughput in million points per second of the kernel called over the same points up to benchTotalPoints
+ */
+template <typename Function>
+double measure(Function function)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 done = 0; done < benchTotalPoints; done += benchPoints)
+    {
+        function();
+    }
+    const qint64 ns = std::max(timer.nsecsElapsed(), qint64(1));
+    return static_cast<double>(benchTotalPoints) * 1000 / ns;
+}
+
+void report(const char *name, double referenceRate, double rate)
+{
+    qInfo().nospace() << "  " << name << ": reference " << qRound(referenceRate) << " Mpoints/s, kernel "
+                      << qRound(rate) << " Mpoints/s, speedup " << rate / referenceRate;
+}
+}
+
+int main()
+{
+    QRandomGenerator random(randomSeed);
+    qInfo() << "Kernels:" << PsdAnalysis::instructionSet();
+
+    for (int count = 0; count <= checkedPointsMax; count++)
+    {
+        for (int idx = 0; idx < buffersPerLength; idx++)
+        {
+            bool result = checkPoints(randomPoints(random, count), count);
+            if (result == false)
+            {
+                return 1;
+            }
+        }
+    }
+    qInfo() << "Kernels match reference on" << (checkedPointsMax + 1) * buffersPerLength << "random buffers";
+
+    const QByteArray data = randomPoints(random, benchPoints);
+    const char *points = data.constData() + 1;
+    std::vector<float> decibels(benchPoints);
+    // Results are accumulated, so the calls aren't optimised out
+    double sink = 0;
+
+    qInfo() << "PSD packet of" << benchPoints << "points:";
+    report("sum",
+           measure([&] { sink += referenceSum(points, benchPoints); }),
+           measure([&] { sink += PsdAnalysis::sum(points, benchPoints); }));
+    report("peak",
+           measure([&] { sink += referencePeak(points, benchPoints); }),
+           measure([&] { sink += PsdAnalysis::peak(points, benchPoints); }));
+    report("dB",
+           measure([&] { referenceDecibels(points, benchPoints, decibels.data()); sink += decibels[0]; }),
+           measure([&] { PsdAnalysis::toDecibels(points, benchPoints, decibels.data()); sink += decibels[0]; }));
+    qDebug() << "Checksum" << sink;
+
+    return 0;
+}
@@ -0,0 +1,14 @@
+QT       = core
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../psdanalysis.cpp \
+    psdbench.cpp
+
+HEADERS += \
+    ../../packets.h \
+    ../../psdanalysis.h
@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    crc16bench \
+    downloadbench \
+    parserbench \
+    psdbench